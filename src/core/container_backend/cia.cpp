@@ -4,6 +4,7 @@
 #include "core/container_backend/ncch.h"
 #include "core/container_backend/sha.h"
 #include "core/file_backend/aes_cbc.h"
+#include "core/file_backend/cached_file.h"
 #include "core/file_backend/memory_file.h"
 #include "core/secret_backend/secret_database.h"
 #include <unordered_map>
@@ -16,17 +17,20 @@ std::unordered_map<u32, std::size_t> signature_size{
     {0x10005, 0x80},
 };
 
+// Ticket and TMD start with a signature whose size depends on its type
+static constexpr Schema signature_schema{
+    Member<be_<u32>>("SignatureType", 0x0),
+};
+
 class Ticket : public FileContainer {
 public:
   Ticket(FB::FilePtr file_) : FileContainer(std::move(file_)) {
-    InstallList({
-        Field<be_<u32>>("SignatureType", 0x0),
-    });
-    main_offset = signature_size[Open("SignatureType")->ValueT<u32>()];
-
-    InstallList({
-        Field<u8>("KeyIndex", 0xB1 + main_offset),
-    });
+    // a ticket is a few hundred bytes, so all fields come from one read
+    SnapshotHeader(file->GetSize());
+    signature = DecodeHeader(signature_schema);
+    main_offset = signature_size[std::get<0>(signature)];
+    body = DecodeHeader(body_schema, main_offset);
+    InstallTable(Handlers());
 
     std::string error = TitleKeyError();
     InstallList({
@@ -41,29 +45,44 @@ public:
   }
 
 private:
+  static const HandlerTable &Handlers() {
+    static const HandlerTable table(
+        Join(SchemaHandlers(signature_schema, &Ticket::signature),
+             SchemaHandlers(body_schema, &Ticket::body)));
+    return table;
+  }
+
+  // offsets are from the end of the signature
+  static constexpr Schema body_schema{
+      Member<u8>("KeyIndex", 0xB1),
+  };
+
+  decltype(signature_schema)::Record signature;
+  decltype(body_schema)::Record body;
   std::size_t main_offset;
   SB::SecretContext secrets;
 
+  u8 KeyIndex() const { return std::get<body_schema.Find("KeyIndex")>(body); }
+
   std::string TitleKeyError() {
     if (secrets[SB::k_sec_aes_const].size() != 0x10)
       return SB::k_sec_aes_const;
     if (secrets[SB::k_sec_key3D_x].size() != 0x10)
       return SB::k_sec_key3D_x;
-    u8 key_index = Open("KeyIndex")->ValueT<u8>();
+    u8 key_index = KeyIndex();
     if (secrets[SB::k_sec_key3D_y[key_index]].size() != 0x10)
       return SB::k_sec_key3D_y[key_index];
     return "";
   }
 
   FB::FilePtr TitleKey() {
-    auto encrypted =
-        std::make_shared<FB::SubFile>(file, 0x7F + main_offset, 0x10);
+    auto encrypted = HeaderRegion(0x7F + main_offset, 0x10);
     byte_seq title_id; // gcc 7 bug: must separate here
-    title_id = file->Read(0x9C + main_offset, 8);
+    title_id = HeaderRegion(0x9C + main_offset, 8)->Read(0, 8);
     auto iv =
         std::make_shared<FB::MemoryFile>(title_id.begin(), title_id.end());
     iv->resize(16, byte{0});
-    u8 key_index = Open("KeyIndex")->ValueT<u8>();
+    u8 key_index = KeyIndex();
     AESKey x, y, c;
     std::memcpy(x.data(), secrets[SB::k_sec_key3D_x].data(), 0x10);
     std::memcpy(y.data(), secrets[SB::k_sec_key3D_y[key_index]].data(), 0x10);
@@ -78,171 +97,204 @@ private:
 class Tmd : public FileContainer {
 public:
   Tmd(FB::FilePtr file_) : FileContainer(std::move(file_)) {
-    InstallList({
-        Field<be_<u32>>("SignatureType", 0x0),
-    });
-    main_offset = signature_size[Open("SignatureType")->ValueT<u32>()];
+    // the content records follow the header, so one read of the whole TMD
+    // covers every field
+    SnapshotHeader(file->GetSize());
+    signature = DecodeHeader(signature_schema);
+    main_offset = signature_size[std::get<0>(signature)];
+    body = DecodeHeader(body_schema, main_offset);
+    InstallTable(Handlers());
 
-    InstallList({
-        Field<be_<u16>>("ContentCount", 0x9E + main_offset),
-    });
+    u16 content_count = std::get<body_schema.Find("ContentCount")>(body);
+    std::size_t records = 0x9C4 + main_offset;
+    contents = DecodeTable(content_schema, records, 0x30, content_count);
+    InstallArrays(SchemaArrays(content_schema, contents));
 
-    u16 content_count = Open("ContentCount")->ValueT<u16>();
-    for (u16 i = 0; i < content_count; ++i) {
-      InstallList({
-          Field<be_<u32>>(WithIndex("ContentId", i),
-                          0x9C4 + main_offset + i * 0x30 + 0x0),
-          Field<be_<u16>>(WithIndex("ContentIndex", i),
-                          0x9C4 + main_offset + i * 0x30 + 0x4),
-          Field<be_<u16>>(WithIndex("ContentType", i),
-                          0x9C4 + main_offset + i * 0x30 + 0x6),
-          Field<be_<u64>>(WithIndex("ContentSize", i),
-                          0x9C4 + main_offset + i * 0x30 + 0x8),
-          {WithIndex("ContentHash", i),
-           [this, i]() {
-             return std::make_shared<FileContainer>(
-                 std::make_shared<FB::SubFile>(
-                     file, 0x9C4 + main_offset + i * 0x30 + 0x10, 0x20));
-           }},
-
-          {WithIndex("ContentIv", i),
-           [this, i]() {
-             byte_seq iv_data; // gcc 7 bug: must separate here
-             iv_data = file->Read(0x9C4 + main_offset + i * 0x30 + 0x4, 2);
-             iv_data.resize(16, byte{0});
-             auto iv = std::make_shared<FB::MemoryFile>(iv_data.begin(),
-                                                        iv_data.end());
-             return std::make_shared<FileContainer>(iv);
-           }},
-          {WithIndex("ContentIsEncrypted", i),
-           [this, i]() {
-             return std::make_shared<ConstContainer>(
-                 (Open(WithIndex("ContentType", i))->ValueT<u16>() & 0x1) != 0);
-           }},
-          {WithIndex("ContentIsDisc", i),
-           [this, i]() {
-             return std::make_shared<ConstContainer>(
-                 (Open(WithIndex("ContentType", i))->ValueT<u16>() & 0x2) != 0);
-           }},
-          {WithIndex("ContentIsCfm", i),
-           [this, i]() {
-             return std::make_shared<ConstContainer>(
-                 (Open(WithIndex("ContentType", i))->ValueT<u16>() & 0x4) != 0);
-           }},
-          {WithIndex("ContentIsOptional", i),
-           [this, i]() {
-             return std::make_shared<ConstContainer>(
-                 (Open(WithIndex("ContentType", i))->ValueT<u16>() & 0x4000) !=
-                 0);
-           }},
-          {WithIndex("ContentIsShared", i),
-           [this, i]() {
-             return std::make_shared<ConstContainer>(
-                 (Open(WithIndex("ContentType", i))->ValueT<u16>() & 0x8000) !=
-                 0);
-           }},
-      });
-    }
+    auto type_flag = [this](std::size_t i, u16 mask) {
+      u16 type = std::get<content_schema.Find("ContentType")>(contents[i]);
+      return std::make_shared<ConstContainer>((type & mask) != 0);
+    };
+    InstallArrays({
+        {"ContentHash", content_count,
+         [this, records](std::size_t i) {
+           std::size_t offset = records + i * 0x30 + 0x10;
+           return std::make_shared<FileContainer>(HeaderRegion(offset, 0x20));
+         }},
+        {"ContentIv", content_count,
+         [this, records](std::size_t i) {
+           byte_seq iv_data; // gcc 7 bug: must separate here
+           std::size_t offset = records + i * 0x30 + 0x4;
+           iv_data = HeaderRegion(offset, 2)->Read(0, 2);
+           iv_data.resize(16, byte{0});
+           auto iv =
+               std::make_shared<FB::MemoryFile>(iv_data.begin(), iv_data.end());
+           return std::make_shared<FileContainer>(iv);
+         }},
+        {"ContentIsEncrypted", content_count,
+         [type_flag](std::size_t i) { return type_flag(i, 0x1); }},
+        {"ContentIsDisc", content_count,
+         [type_flag](std::size_t i) { return type_flag(i, 0x2); }},
+        {"ContentIsCfm", content_count,
+         [type_flag](std::size_t i) { return type_flag(i, 0x4); }},
+        {"ContentIsOptional", content_count,
+         [type_flag](std::size_t i) { return type_flag(i, 0x4000); }},
+        {"ContentIsShared", content_count,
+         [type_flag](std::size_t i) { return type_flag(i, 0x8000); }},
+    });
   }
 
 private:
+  static const HandlerTable &Handlers() {
+    static const HandlerTable table(
+        Join(SchemaHandlers(signature_schema, &Tmd::signature),
+             SchemaHandlers(body_schema, &Tmd::body)));
+    return table;
+  }
+
+  // offsets are from the end of the signature
+  static constexpr Schema body_schema{
+      Member<be_<u16>>("ContentCount", 0x9E),
+  };
+
+  // one record per content, 0x30 bytes apart
+  static constexpr Schema content_schema{
+      Member<be_<u32>>("ContentId", 0x0),
+      Member<be_<u16>>("ContentIndex", 0x4),
+      Member<be_<u16>>("ContentType", 0x6),
+      Member<be_<u64>>("ContentSize", 0x8),
+  };
+
+  decltype(signature_schema)::Record signature;
+  decltype(body_schema)::Record body;
+  std::vector<decltype(content_schema)::Record> contents;
   std::size_t main_offset;
 };
 
+const ContainerHelper::HandlerTable &Cia::Handlers() {
+  static const HandlerTable table(SchemaHandlers(header_schema, &Cia::header));
+  return table;
+}
+
 Cia::Cia(FB::FilePtr file_) : FileContainer(std::move(file_)) {
-  InstallList({
-      Field<u32>("HeaderSize", 0x0),
-      Field<u16>("Type", 0x4),
-      Field<u16>("Version", 0x6),
-      Field<u32>("CertificateChainSize", 0x8),
-      Field<u32>("TicketSize", 0xC),
-      Field<u32>("TmdSize", 0x10),
-      Field<u32>("MetadataSize", 0x14),
-      Field<u64>("ContentSize", 0x18),
-  });
+  SnapshotHeader(0x20);
+  header = DecodeHeader(header_schema);
+  InstallTable(Handlers());
 
   u64 offset = 0;
-  offset += Open("HeaderSize")->ValueT<u32>();
+  offset += std::get<header_schema.Find("HeaderSize")>(header);
   offset = AlignUp(offset, 64);
 
-  u32 certificate_chain_size = Open("CertificateChainSize")->ValueT<u32>();
+  u32 certificate_chain_size =
+      std::get<header_schema.Find("CertificateChainSize")>(header);
   // FB::FilePtr certificate_chain = std::make_shared<FB::SubFile>(file, offset,
   // certificate_chain_size);
   offset += certificate_chain_size;
   offset = AlignUp(offset, 64);
 
-  u32 ticket_size = Open("TicketSize")->ValueT<u32>();
+  u32 ticket_size = std::get<header_schema.Find("TicketSize")>(header);
   FB::FilePtr ticket = std::make_shared<FB::SubFile>(file, offset, ticket_size);
   offset += ticket_size;
   offset = AlignUp(offset, 64);
 
-  u32 tmd_size = Open("TmdSize")->ValueT<u32>();
+  u32 tmd_size = std::get<header_schema.Find("TmdSize")>(header);
   FB::FilePtr tmd = std::make_shared<FB::SubFile>(file, offset, tmd_size);
   offset += tmd_size;
   offset = AlignUp(offset, 64);
 
-  u64 content_size = Open("ContentSize")->ValueT<u64>();
+  u64 content_size = std::get<header_schema.Find("ContentSize")>(header);
   content = std::make_shared<FB::SubFile>(file, offset, content_size);
   offset += content_size;
   offset = AlignUp(offset, 64);
 
-  u32 metadata_size = Open("MetadataSize")->ValueT<u32>();
+  u32 metadata_size = std::get<header_schema.Find("MetadataSize")>(header);
   metadata = std::make_shared<FB::SubFile>(file, offset, metadata_size);
 
   InstallList({
-      {"Ticket", [ticket]() { return std::make_shared<Ticket>(ticket); }},
-      {"Tmd", [tmd]() { return std::make_shared<Tmd>(tmd); }},
+      Cached({"Ticket",
+              [ticket]() { return std::make_shared<Ticket>(ticket); }}),
+      Cached({"Tmd", [tmd]() { return std::make_shared<Tmd>(tmd); }}),
   });
 
-  auto tmd_container = Open("Tmd");
-  auto ticket_container = Open("Ticket");
-  std::string title_key_error =
-      ticket_container->Open("TitleKeyError")->ValueT<std::string>();
-  FB::FilePtr title_key;
-  if (title_key_error.empty()) {
-    title_key = ticket_container->Open("TitleKey")->ValueT<FB::FilePtr>();
+  // The content decorators and the title key behind them are set up on
+  // first access. Only the content count is needed here.
+  u16 content_count = Open("Tmd")->Open("ContentCount")->ValueT<u16>();
+  auto content_exists = [this](std::size_t i) {
+    InitContents();
+    return sub_contents[i] != nullptr;
+  };
+  InstallArrays({
+      {"ContentError", content_count,
+       [this](std::size_t i) {
+         InitContents();
+         return std::make_shared<ConstContainer>(content_errors[i]);
+       }},
+      {"Content", content_count,
+       [this](std::size_t i) {
+         InitContents();
+         return std::make_shared<Ncch>(sub_contents[i]);
+       },
+       content_exists, true},
+      {"ContentHash", content_count,
+       [this](std::size_t i) {
+         InitContents();
+         auto hash =
+             Open("Tmd")->OpenAt("ContentHash", i)->ValueT<FB::FilePtr>();
+         return std::make_shared<Sha>(sub_contents[i], hash);
+       },
+       content_exists},
+  });
+}
+
+VerificationResult Cia::Verify(const VerificationOptions &options) {
+  VerificationResult result;
+  std::size_t content_count = ArraySize("Content");
+  for (std::size_t i = 0; i < content_count; ++i) {
+    std::string name = "Content" + std::to_string(i);
+    // Content always makes an Ncch
+    auto content = std::static_pointer_cast<Ncch>(OpenAt("Content", i));
+    if (!content) {
+      result.Add(name, VerificationResult::Status::Unavailable);
+      continue;
+    }
+    if (options.level == VerificationLevel::Full)
+      result.AddMatch(name + "/Hash", OpenAt("ContentHash", i));
+    result.Merge(name + "/", content->Verify(options));
   }
-  u16 content_count = tmd_container->Open("ContentCount")->ValueT<u16>();
-  std::size_t content_offset = 0;
-  for (u16 i = 0; i < content_count; ++i) {
-    u64 size = tmd_container->Open(WithIndex("ContentSize", i))->ValueT<u64>();
-    auto raw = std::make_shared<FB::SubFile>(content, content_offset, size);
-    content_offset += size;
-
-    if (tmd_container->Open(WithIndex("ContentIsEncrypted", i))
-            ->ValueT<bool>()) {
-      InstallList({{WithIndex("ContentError", i), [title_key_error]() {
-                      return std::make_shared<ConstContainer>(title_key_error);
-                    }}});
-      if (title_key_error.empty()) {
-        auto iv = tmd_container->Open(WithIndex("ContentIv", i))
-                      ->ValueT<FB::FilePtr>();
-        sub_contents.push_back(
-            std::make_shared<FB::AesCbcFile>(raw, title_key, iv));
+  return result;
+}
+
+void Cia::InitContents() {
+  std::call_once(contents_once, [this]() {
+    auto tmd_container = Open("Tmd");
+    auto ticket_container = Open("Ticket");
+    std::string title_key_error =
+        ticket_container->Open("TitleKeyError")->ValueT<std::string>();
+    FB::FilePtr title_key;
+    if (title_key_error.empty()) {
+      title_key = ticket_container->Open("TitleKey")->ValueT<FB::FilePtr>();
+    }
+    u16 content_count = tmd_container->Open("ContentCount")->ValueT<u16>();
+    std::size_t content_offset = 0;
+    for (u16 i = 0; i < content_count; ++i) {
+      u64 size = tmd_container->OpenAt("ContentSize", i)->ValueT<u64>();
+      auto raw = std::make_shared<FB::SubFile>(content, content_offset, size);
+      content_offset += size;
+
+      bool encrypted =
+          tmd_container->OpenAt("ContentIsEncrypted", i)->ValueT<bool>();
+      content_errors.push_back(encrypted ? title_key_error : std::string());
+      if (!encrypted) {
+        sub_contents.push_back(raw);
+      } else if (title_key_error.empty()) {
+        auto iv =
+            tmd_container->OpenAt("ContentIv", i)->ValueT<FB::FilePtr>();
+        sub_contents.push_back(std::make_shared<FB::CachedFile>(
+            std::make_shared<FB::AesCbcFile>(raw, title_key, iv)));
       } else {
         sub_contents.push_back(nullptr);
       }
-    } else {
-      InstallList({{WithIndex("ContentError", i), [title_key_error]() {
-                      return std::make_shared<ConstContainer>(std::string());
-                    }}});
-      sub_contents.push_back(raw);
-    }
-
-    if (sub_contents[i]) {
-      InstallList({
-          {WithIndex("Content", i),
-           [this, i]() { return std::make_shared<Ncch>(sub_contents[i]); }},
-          {WithIndex("ContentHash", i),
-           [this, i]() {
-             auto hash = Open("Tmd")
-                             ->Open(WithIndex("ContentHash", i))
-                             ->ValueT<FB::FilePtr>();
-             return std::make_shared<Sha>(sub_contents[i], hash);
-           }},
-      });
     }
-  }
+  });
 }
 
 } // namespace CB
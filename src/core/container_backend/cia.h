@@ -1,6 +1,9 @@
 #pragma once
 
 #include "core/container_backend/container.h"
+#include "core/container_backend/schema.h"
+#include "core/container_backend/verification.h"
+#include <mutex>
 
 namespace CB {
 
@@ -8,9 +11,32 @@ class Cia : public FileContainer {
 public:
   Cia(FB::FilePtr file);
 
+  // The ticket and TMD signatures are not checked. Full also hashes every
+  // content as a whole.
+  VerificationResult Verify(const VerificationOptions &options);
+
 private:
+  static const HandlerTable &Handlers();
+
+  static constexpr Schema header_schema{
+      Member<u32>("HeaderSize", 0x0),
+      Member<u16>("Type", 0x4),
+      Member<u16>("Version", 0x6),
+      Member<u32>("CertificateChainSize", 0x8),
+      Member<u32>("TicketSize", 0xC),
+      Member<u32>("TmdSize", 0x10),
+      Member<u32>("MetadataSize", 0x14),
+      Member<u64>("ContentSize", 0x18),
+  };
+  decltype(header_schema)::Record header;
+
   FB::FilePtr metadata, content;
+
+  // fills sub_contents and content_errors once, on first use
+  void InitContents();
+  std::once_flag contents_once;
   std::vector<FB::FilePtr> sub_contents;
+  std::vector<std::string> content_errors;
 };
 
 } // namespace CB
\ No newline at end of file
@@ -1,32 +1,191 @@
 #include "core/container_backend/container.h"
+#include "core/file_backend/memory_file.h"
 
 namespace CB {
 
 Container::Container() = default;
 Container::~Container() = default;
 
-std::any Container::Value() { return {}; }
+Variant Container::Value() { return {}; }
+
+std::size_t Container::ArraySize(const std::string &name) { return 0; }
+
+ContainerPtr Container::OpenAt(const std::string &name, std::size_t index) {
+  return Open(WithIndex(name, index));
+}
 
 ContainerPtr ContainerHelper::Open(const std::string &name) {
-  auto h = std::find_if(handler_list.begin(), handler_list.end(),
-                        [&](const OpenHandler &h) { return h.name == name; });
-  if (h == handler_list.end())
+  if (table) {
+    if (const TypeHandler *h = table->Find(name)) {
+      if (h->cached)
+        return Memoize(name, [&] { return h->handler(*this); });
+      return h->handler(*this);
+    }
+  }
+  auto found = handler_index.find(name);
+  if (found != handler_index.end()) {
+    const OpenHandler &h = handler_list[found->second];
+    if (h.exists && !h.exists())
+      return nullptr;
+    if (h.cached)
+      return Memoize(name, h.handler);
+    return h.handler();
+  }
+
+  // name[index] of an array
+  std::size_t bracket = name.find('[');
+  if (bracket == std::string::npos || bracket + 2 > name.size() - 1 ||
+      name.back() != ']')
+    return nullptr;
+  std::size_t index = 0;
+  for (std::size_t i = bracket + 1; i < name.size() - 1; ++i) {
+    if (name[i] < '0' || name[i] > '9')
+      return nullptr;
+    index = index * 10 + (std::size_t)(name[i] - '0');
+  }
+  const ArrayHandler *array = FindArray(name.substr(0, bracket));
+  if (!array)
     return nullptr;
-  return h->handler();
+  return OpenAt(array->name, index);
 }
 
 std::vector<std::string> ContainerHelper::List() {
-  std::vector<std::string> result(handler_list.size());
-  std::transform(handler_list.begin(), handler_list.end(), result.begin(),
-                 [](const OpenHandler &h) { return h.name; });
+  std::vector<std::string> result;
+  if (table) {
+    for (const auto &h : table->GetHandlers())
+      result.push_back(h.name);
+  }
+  for (const auto &h : handler_list) {
+    if (!h.exists || h.exists())
+      result.push_back(h.name);
+  }
+  for (const auto &array : array_list) {
+    for (std::size_t i = 0; i < array.size; ++i) {
+      if (!array.exists || array.exists(i))
+        result.push_back(WithIndex(array.name, i));
+    }
+  }
   return result;
 }
 
+std::size_t ContainerHelper::ArraySize(const std::string &name) {
+  const ArrayHandler *array = FindArray(name);
+  return array ? array->size : 0;
+}
+
+ContainerPtr ContainerHelper::OpenAt(const std::string &name,
+                                     std::size_t index) {
+  const ArrayHandler *array = FindArray(name);
+  if (!array)
+    return Container::OpenAt(name, index);
+  if (index >= array->size || (array->exists && !array->exists(index)))
+    return nullptr;
+  if (array->cached)
+    return Memoize(WithIndex(name, index),
+                   [&] { return array->handler(index); });
+  return array->handler(index);
+}
+
 void ContainerHelper::InstallList(const HandlerList &list) {
-  handler_list.insert(handler_list.end(), list.begin(), list.end());
+  for (const auto &h : list) {
+    handler_index.emplace(h.name, handler_list.size());
+    handler_list.push_back(h);
+  }
+}
+
+void ContainerHelper::InstallArrays(const ArrayHandlerList &list) {
+  for (const auto &a : list) {
+    array_index.emplace(a.name, array_list.size());
+    array_list.push_back(a);
+  }
+}
+
+void ContainerHelper::InstallTable(const HandlerTable &table) {
+  this->table = &table;
+}
+
+std::vector<ContainerHelper::TypeHandler>
+ContainerHelper::Join(std::vector<TypeHandler> first,
+                      const std::vector<TypeHandler> &second) {
+  first.insert(first.end(), second.begin(), second.end());
+  return first;
+}
+
+ContainerHelper::OpenHandler ContainerHelper::Cached(OpenHandler handler) {
+  handler.cached = true;
+  return handler;
+}
+
+ContainerHelper::ArrayHandler ContainerHelper::Cached(ArrayHandler handler) {
+  handler.cached = true;
+  return handler;
 }
 
-std::any FileContainer::Value() { return file; }
+ContainerHelper::TypeHandler ContainerHelper::Cached(TypeHandler handler) {
+  handler.cached = true;
+  return handler;
+}
+
+template <typename F>
+ContainerPtr ContainerHelper::Memoize(const std::string &key, F make) {
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto c = cache.find(key);
+    if (c != cache.end())
+      return c->second;
+  }
+
+  // make() runs unlocked, as making a child may open other children of this
+  // container. If two threads race here, both get the child stored first.
+  ContainerPtr child = make();
+  if (!child)
+    return child;
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  return cache.emplace(key, std::move(child)).first->second;
+}
+
+const ContainerHelper::ArrayHandler *
+ContainerHelper::FindArray(const std::string &name) const {
+  auto a = array_index.find(name);
+  return a == array_index.end() ? nullptr : &array_list[a->second];
+}
+
+ContainerHelper::HandlerTable::HandlerTable(std::vector<TypeHandler> handlers)
+    : handlers(std::move(handlers)) {
+  for (std::size_t i = 0; i < this->handlers.size(); ++i)
+    index.emplace(this->handlers[i].name, i);
+}
+
+const ContainerHelper::TypeHandler *
+ContainerHelper::HandlerTable::Find(const std::string &name) const {
+  auto h = index.find(name);
+  return h == index.end() ? nullptr : &handlers[h->second];
+}
+
+const std::vector<ContainerHelper::TypeHandler> &
+ContainerHelper::HandlerTable::GetHandlers() const {
+  return handlers;
+}
+
+Variant FileContainer::Value() { return file; }
+
+void FileContainer::SnapshotHeader(std::size_t size) {
+  snapshot = std::make_shared<FB::MemoryFile>(file->Read(0, size));
+}
+
+FB::FilePtr FileContainer::FieldSource(std::size_t offset,
+                                       std::size_t size) const {
+  if (snapshot && offset <= snapshot->GetSize() &&
+      size <= snapshot->GetSize() - offset)
+    return snapshot;
+  return file;
+}
+
+FB::FilePtr FileContainer::HeaderRegion(std::size_t offset,
+                                        std::size_t size) const {
+  return std::make_shared<FB::SubFile>(FieldSource(offset, size), offset,
+                                       size);
+}
 
 std::string WithIndex(const std::string &base, std::size_t index) {
   return base + "[" + std::to_string(index) + "]";
@@ -1,14 +1,18 @@
 #pragma once
 
+#include "core/container_backend/variant.h"
 #include "core/file_backend/file.h"
 #include "core/file_backend/sub_file.h"
 #include <algorithm>
-#include <any>
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace CB {
@@ -26,28 +30,109 @@ public:
   virtual ~Container();
   virtual ContainerPtr Open(const std::string &name) = 0;
   virtual std::vector<std::string> List() = 0;
-  virtual std::any Value();
+  virtual Variant Value();
 
-  template <typename T> T ValueT() { return std::any_cast<T>(Value()); }
+  // Indexed children, which are also reachable with Open("name[index]").
+  // ArraySize returns 0 if there is no array with this name.
+  virtual std::size_t ArraySize(const std::string &name);
+  virtual ContainerPtr OpenAt(const std::string &name, std::size_t index);
+
+  // Throws std::bad_variant_access if the value is not a T
+  template <typename T> T ValueT() { return Value().template Get<T>(); }
 };
 
 class ContainerHelper : public Container {
 public:
   ContainerPtr Open(const std::string &name) override;
   std::vector<std::string> List() override;
+  std::size_t ArraySize(const std::string &name) override;
+  ContainerPtr OpenAt(const std::string &name, std::size_t index) override;
 
 protected:
+  // If exists is set and returns false, the child is left out. If cached is
+  // set, the first child opened is kept and returned by every later Open.
+  // Only for children that never change.
   struct OpenHandler {
     std::string name;
     std::function<ContainerPtr()> handler;
+    std::function<bool()> exists;
+    bool cached = false;
+  };
+
+  // Elements are created on demand by handler. If exists is set, elements
+  // for which it returns false are left out.
+  struct ArrayHandler {
+    std::string name;
+    std::size_t size;
+    std::function<ContainerPtr(std::size_t index)> handler;
+    std::function<bool(std::size_t index)> exists;
+    bool cached = false;
+  };
+
+  // A handler shared by all instances of a container type. It gets the
+  // instance it is opened on.
+  struct TypeHandler {
+    std::string name;
+    std::function<ContainerPtr(ContainerHelper &self)> handler;
+    bool cached = false;
+  };
+
+  // The handlers of a container type, built once (typically as a
+  // function-local static) with a hash index over the names
+  class HandlerTable {
+  public:
+    HandlerTable(std::vector<TypeHandler> handlers);
+
+    const TypeHandler *Find(const std::string &name) const;
+    const std::vector<TypeHandler> &GetHandlers() const;
+
+  private:
+    std::vector<TypeHandler> handlers;
+    std::unordered_map<std::string, std::size_t> index;
   };
 
   using HandlerList = std::vector<OpenHandler>;
+  using ArrayHandlerList = std::vector<ArrayHandler>;
 
   void InstallList(const HandlerList &list);
+  void InstallArrays(const ArrayHandlerList &list);
+
+  // The table must outlive the container. Its handlers take precedence over
+  // those installed with InstallList.
+  void InstallTable(const HandlerTable &table);
+
+  static std::vector<TypeHandler> Join(std::vector<TypeHandler> first,
+                                       const std::vector<TypeHandler> &second);
+
+  static OpenHandler Cached(OpenHandler handler);
+  static ArrayHandler Cached(ArrayHandler handler);
+  static TypeHandler Cached(TypeHandler handler);
+
+  // A table handler calling f with the instance cast to the derived type T
+  template <typename T, typename F>
+  static TypeHandler Bind(const std::string &name, F f) {
+    return {name, [f](ContainerHelper &self) -> ContainerPtr {
+              return f(static_cast<T &>(self));
+            }};
+  }
 
 private:
+  const ArrayHandler *FindArray(const std::string &name) const;
+
+  // Returns the child cached under key, making it with make() first if
+  // there is none
+  template <typename F> ContainerPtr Memoize(const std::string &key, F make);
+
+  const HandlerTable *table = nullptr;
   HandlerList handler_list;
+  ArrayHandlerList array_list;
+
+  // first handler of each name, by position in the lists above
+  std::unordered_map<std::string, std::size_t> handler_index;
+  std::unordered_map<std::string, std::size_t> array_index;
+
+  std::mutex cache_mutex;
+  std::unordered_map<std::string, ContainerPtr> cache;
 };
 
 // a label for big endian field
@@ -61,12 +146,14 @@ template <typename T> class SimpleField : public ContainerHelper {
                 "T must be trivially copyable!");
 
 public:
+  static constexpr std::size_t field_size = sizeof(T);
+
   SimpleField(FB::FilePtr file) : file(std::move(file)) {}
   SimpleField(FB::FilePtr file, std::size_t offset)
       : file(std::make_shared<FB::SubFile>(std::move(file), offset,
                                            sizeof(T))) {}
 
-  std::any Value() override { return file->Read<T>(0); }
+  Variant Value() override { return file->Read<T>(0); }
 
 private:
   FB::FilePtr file;
@@ -74,41 +161,125 @@ private:
 
 template <typename T> class SimpleField<be_<T>> : public ContainerHelper {
 public:
+  static constexpr std::size_t field_size = sizeof(T);
+
   SimpleField(FB::FilePtr file) : file(std::move(file)) {}
   SimpleField(FB::FilePtr file, std::size_t offset)
       : file(std::make_shared<FB::SubFile>(std::move(file), offset,
                                            sizeof(T))) {}
 
-  std::any Value() override { return swap(file->Read<T>(0)); }
+  Variant Value() override { return swap(file->Read<T>(0)); }
 
 private:
   FB::FilePtr file;
 };
 
+class ConstContainer : public ContainerHelper {
+public:
+  ConstContainer(Variant value) : value(std::move(value)) {}
+  Variant Value() override { return value; }
+
+private:
+  Variant value;
+};
+
 class FileContainer : public ContainerHelper {
 public:
   FileContainer(FB::FilePtr file) : file(std::move(file)) {}
 
-  std::any Value() override;
+  Variant Value() override;
 
 protected:
+  // Reads the first size bytes of file in one go. Fields inside that range
+  // are then decoded from the copy instead of each reading file.
+  void SnapshotHeader(std::size_t size);
+
+  // The header snapshot if it holds [offset, offset + size), otherwise file
+  FB::FilePtr FieldSource(std::size_t offset, std::size_t size) const;
+
+  // A view of [offset, offset + size), served from the snapshot if possible
+  FB::FilePtr HeaderRegion(std::size_t offset, std::size_t size) const;
+
   template <typename T>
   OpenHandler Field(const std::string name, std::size_t offset) {
-    return {name, [this, offset]() {
-              return std::make_shared<SimpleField<T>>(file, offset);
-            }};
+    return {name, [this, offset]() { return MakeField<T>(offset); }};
   }
 
-  FB::FilePtr file;
-};
+  // Decodes a Schema (see schema.h) from the bytes at base. Bytes past the
+  // end of file decode as zero.
+  template <typename S>
+  typename S::Record DecodeHeader(const S &schema, std::size_t base = 0) const {
+    std::size_t size = schema.Extent();
+    byte_seq data = FieldSource(base, size)->Read(base, size);
+    data.resize(size);
+    return schema.Decode(data.data());
+  }
 
-class ConstContainer : public ContainerHelper {
-public:
-  ConstContainer(std::any value) : value(std::move(value)) {}
-  std::any Value() override { return value; }
+  // Decodes count records of a Schema placed stride bytes apart from base,
+  // with one read for the whole table
+  template <typename S>
+  std::vector<typename S::Record> DecodeTable(const S &schema,
+                                              std::size_t base,
+                                              std::size_t stride,
+                                              std::size_t count) const {
+    std::size_t size = count == 0 ? 0 : stride * (count - 1) + schema.Extent();
+    byte_seq data = FieldSource(base, size)->Read(base, size);
+    data.resize(size);
+    std::vector<typename S::Record> records;
+    records.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+      records.push_back(schema.Decode(data.data() + i * stride));
+    return records;
+  }
+
+  // Table handlers for the fields of the record member of C
+  template <typename C, typename S>
+  static std::vector<TypeHandler>
+  SchemaHandlers(const S &schema, typename S::Record C::*record) {
+    return SchemaHandlers<C>(schema, record,
+                             std::make_index_sequence<S::count>{});
+  }
+
+  // One array per field of the records, which must outlive the container
+  template <typename S>
+  ArrayHandlerList
+  SchemaArrays(const S &schema,
+               const std::vector<typename S::Record> &records) {
+    return SchemaArrays(schema, records, std::make_index_sequence<S::count>{});
+  }
+
+  FB::FilePtr file;
 
 private:
-  std::any value;
+  template <typename C, typename S, std::size_t... I>
+  static std::vector<TypeHandler>
+  SchemaHandlers(const S &schema, typename S::Record C::*record,
+                 std::index_sequence<I...>) {
+    return {TypeHandler{schema.template Name<I>(),
+                        [record](ContainerHelper &self) -> ContainerPtr {
+                          return std::make_shared<ConstContainer>(
+                              std::get<I>(static_cast<C &>(self).*record));
+                        }}...};
+  }
+
+  template <typename S, std::size_t... I>
+  ArrayHandlerList SchemaArrays(const S &schema,
+                                const std::vector<typename S::Record> &records,
+                                std::index_sequence<I...>) {
+    return {ArrayHandler{schema.template Name<I>(), records.size(),
+                         [&records](std::size_t index) -> ContainerPtr {
+                           return std::make_shared<ConstContainer>(
+                               std::get<I>(records[index]));
+                         }}...};
+  }
+
+  template <typename T>
+  std::shared_ptr<SimpleField<T>> MakeField(std::size_t offset) const {
+    return std::make_shared<SimpleField<T>>(
+        FieldSource(offset, SimpleField<T>::field_size), offset);
+  }
+
+  FB::FilePtr snapshot;
 };
 
 std::string WithIndex(const std::string &base, std::size_t index);
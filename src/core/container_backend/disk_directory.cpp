@@ -1,5 +1,5 @@
 #include "core/container_backend/disk_directory.h"
-#include "core/file_backend/disk_file.h"
+#include "core/file_backend/mapped_file.h"
 
 #ifdef __GNUC__
 #include <experimental/filesystem>
@@ -34,7 +34,7 @@ DiskDirectory::DiskDirectory(const std::string &path_string) {
     } else if (entry.status().type() == stdfs::file_type::regular) {
       InstallList({{sub_name, [sub_path]() {
                       return std::make_shared<FileContainer>(
-                          FB::OpenDiskFile(sub_path));
+                          FB::OpenMappedFile(sub_path));
                     }}});
     }
   }
@@ -1,6 +1,7 @@
 #include "core/container_backend/exefs.h"
 #include "core/container_backend/sha.h"
 #include "core/container_backend/smdh.h"
+#include "core/file_backend/memory_file.h"
 #include <iostream>
 namespace CB {
 
@@ -11,8 +12,11 @@ Exefs::Exefs(FB::FilePtr primary_, FB::FilePtr secondary_)
     u32 offset;
     u32 size;
   };
+  // the file headers and hashes are all in the first 0x200 bytes
+  auto header_region =
+      std::make_shared<FB::MemoryFile>(primary->Read(0, 0x200));
   for (unsigned i = 0; i < 10; ++i) {
-    auto header = primary->Read<FileHeader>(i * sizeof(FileHeader));
+    auto header = header_region->Read<FileHeader>(i * sizeof(FileHeader));
     std::string name(header.name.begin(), header.name.end());
     auto pos = name.find('\0');
     if (pos != std::string::npos) {
@@ -31,8 +35,8 @@ Exefs::Exefs(FB::FilePtr primary_, FB::FilePtr secondary_)
 
     FB::FilePtr sub_file = std::make_shared<FB::SubFile>(
         overlay_file, 0x200 + header.offset, header.size);
-    FB::FilePtr hash_file =
-        std::make_shared<FB::SubFile>(primary, 0xC0 + (9 - i) * 0x20, 0x20);
+    FB::FilePtr hash_file = std::make_shared<FB::SubFile>(
+        header_region, 0xC0 + (9 - i) * 0x20, 0x20);
 
     if (name == "icon") {
       InstallList(
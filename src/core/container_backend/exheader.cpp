@@ -4,36 +4,45 @@
 
 namespace CB {
 
-Exheader::Exheader(FB::FilePtr file) : FileContainer(std::move(file)) {
-  auto signature_key = secrets[SB::k_sec_pubkey_exheader];
-  InstallList({
-      {"Signature",
-       [this, signature_key]() {
-         return std::make_shared<Rsa>(
-             std::make_shared<FB::SubFile>(this->file, 0x500, 0x300),
-             std::make_shared<FB::SubFile>(this->file, 0x400, 0x100),
-             std::make_shared<FB::MemoryFile>(signature_key));
-       }},
-      {"NcchSignaturePublicKey",
-       [this]() {
-         return std::make_shared<FileContainer>(
-             std::make_shared<FB::SubFile>(this->file, 0x500, 0x100));
-       }},
-
-      Field<std::array<char, 8>>("Name", 0x0),
+const ContainerHelper::HandlerTable &Exheader::Handlers() {
+  static const HandlerTable table(Join(
+      SchemaHandlers(header_schema, &Exheader::header),
+      {
+          Bind<Exheader>(
+              "Signature",
+              [](Exheader &self) {
+                return std::make_shared<Rsa>(
+                    std::make_shared<FB::SubFile>(self.file, 0x500, 0x300),
+                    std::make_shared<FB::SubFile>(self.file, 0x400, 0x100),
+                    std::make_shared<FB::MemoryFile>(
+                        self.secrets[SB::k_sec_pubkey_exheader]));
+              }),
+          Bind<Exheader>("NcchSignaturePublicKey",
+                         [](Exheader &self) {
+                           return std::make_shared<FileContainer>(
+                               std::make_shared<FB::SubFile>(self.file, 0x500,
+                                                             0x100));
+                         }),
+          Bind<Exheader>("IsCodeCompressed",
+                         [](Exheader &self) {
+                           return std::make_shared<ConstContainer>(
+                               (self.SciFlags() & 1) != 0);
+                         }),
+          Bind<Exheader>("IsSdApp",
+                         [](Exheader &self) {
+                           return std::make_shared<ConstContainer>(
+                               (self.SciFlags() & 2) != 0);
+                         }),
+      }));
+  return table;
+}
 
-      {"IsCodeCompressed",
-       [this]() {
-         return std::make_shared<ConstContainer>((SciFlags() & 1) != 0);
-       }},
-      {"IsSdApp",
-       [this]() {
-         return std::make_shared<ConstContainer>((SciFlags() & 2) != 0);
-       }},
-      Field<u16>("RemasterVersion", 0xE),
-  });
+Exheader::Exheader(FB::FilePtr file) : FileContainer(std::move(file)) {
+  SnapshotHeader(0x10);
+  header = DecodeHeader(header_schema);
+  InstallTable(Handlers());
 }
 
-u8 Exheader::SciFlags() { return file->Read<u8>(0xD); }
+u8 Exheader::SciFlags() { return FieldSource(0xD, 1)->Read<u8>(0xD); }
 
 } // namespace CB
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core/container_backend/container.h"
+#include "core/container_backend/schema.h"
 #include "core/secret_backend/secret_database.h"
 
 namespace CB {
@@ -10,6 +11,14 @@ public:
   Exheader(FB::FilePtr file);
 
 private:
+  static const HandlerTable &Handlers();
+
+  static constexpr Schema header_schema{
+      Member<std::array<char, 8>>("Name", 0x0),
+      Member<u16>("RemasterVersion", 0xE),
+  };
+  decltype(header_schema)::Record header;
+
   SB::SecretContext secrets;
   u8 SciFlags();
 };
@@ -0,0 +1,232 @@
+#include "core/container_backend/ivfc_verifier.h"
+#include "core/crypto/sha256.h"
+#include "core/thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+namespace CB {
+
+// Blocks are verified in tasks of about this many bytes
+constexpr u64 k_task_size = 0x400000;
+
+IvfcVerifier::IvfcVerifier(const ContainerPtr &romfs) {
+  for (std::size_t i = 0; i < 3; ++i) {
+    auto level = romfs->Open("Level" + std::to_string(i));
+    AddLevel(level->Open("Data")->ValueT<FB::FilePtr>(),
+             level->Open("HashData")->ValueT<FB::FilePtr>(),
+             level->Open("BlockSize")->ValueT<u64>());
+  }
+}
+
+void IvfcVerifier::AddLevel(FB::FilePtr data, FB::FilePtr hash,
+                            u64 block_size) {
+  u64 count = hash->GetSize() / Crypto::SHA256_DIGEST_SIZE;
+  levels.push_back({std::move(data), std::move(hash), block_size, count});
+  total_blocks += count;
+}
+
+void IvfcVerifier::SetProgressCallback(ProgressCallback callback,
+                                       double max_rate) {
+  progress = std::move(callback);
+  progress_interval = std::chrono::duration_cast<
+      std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(1 / max_rate));
+}
+
+void IvfcVerifier::SetSampling(double fraction, u64 seed) {
+  sample_fraction = fraction;
+  sample_seed = seed;
+}
+
+void IvfcVerifier::ReportProgress(bool force) {
+  if (!progress)
+    return;
+  std::unique_lock<std::mutex> lock(progress_mutex, std::defer_lock);
+  if (force) {
+    lock.lock();
+  } else if (!lock.try_lock()) {
+    return; // someone else is reporting right now
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (!force && now - last_progress < progress_interval)
+    return;
+  last_progress = now;
+  if (!progress(done_blocks, planned_blocks))
+    canceled = true;
+}
+
+std::vector<IvfcVerifier::BlockRange>
+IvfcVerifier::PlanLevel(std::size_t index, std::mt19937_64 &random) {
+  const Level &level = levels[index];
+  u64 blocks_per_task = std::max<u64>(1, k_task_size / level.block_size);
+  std::vector<BlockRange> tasks;
+  if (sample_fraction >= 1) {
+    for (u64 first = 0; first < level.count; first += blocks_per_task)
+      tasks.push_back({first, std::min(blocks_per_task, level.count - first)});
+    return tasks;
+  }
+
+  // pick distinct blocks with Floyd's algorithm, without a list of all blocks
+  u64 samples = (u64)std::ceil(level.count * std::max(sample_fraction, 0.0));
+  samples = std::min(level.count, std::max<u64>(samples, 1));
+  std::unordered_set<u64> picked;
+  for (u64 last = level.count - samples; last < level.count; ++last) {
+    u64 block = std::uniform_int_distribution<u64>(0, last)(random);
+    picked.insert(picked.count(block) ? last : block);
+  }
+  std::vector<u64> blocks(picked.begin(), picked.end());
+  std::sort(blocks.begin(), blocks.end());
+
+  // blocks next to each other are read together
+  for (u64 block : blocks) {
+    if (!tasks.empty() && tasks.back().first + tasks.back().count == block &&
+        tasks.back().count < blocks_per_task) {
+      ++tasks.back().count;
+    } else {
+      tasks.push_back({block, 1});
+    }
+  }
+  return tasks;
+}
+
+void IvfcVerifier::VerifyLevel(std::size_t index,
+                               const std::vector<BlockRange> &tasks) {
+  const Level &level = levels[index];
+
+  auto &cache = VerificationCache::Global();
+  VerificationCache::Subject subject;
+  byte_seq parameters(sizeof(u64));
+  std::memcpy(parameters.data(), &level.block_size, sizeof(u64));
+  bool cacheable = cache.MakeSubject("ivfc-sha256", {level.data, level.hash},
+                                     parameters, subject);
+  std::vector<BlockRange> good;
+  if (cacheable)
+    good = cache.GoodBlocks(subject);
+  // scattered samples would split the ranges in the cache into many pieces
+  bool record = cacheable && sample_fraction >= 1;
+
+  std::vector<std::vector<MismatchRange>> task_mismatches(tasks.size());
+  ThreadPool::Global().ParallelFor(tasks.size(), [&](std::size_t task) {
+    if (canceled)
+      return;
+    u64 first = tasks[task].first;
+    u64 count = tasks[task].count;
+
+    // skip tasks that passed as a whole before
+    auto known = std::upper_bound(
+        good.begin(), good.end(), first,
+        [](u64 block, const auto &range) { return block < range.first; });
+    if (known != good.begin() &&
+        std::prev(known)->first + std::prev(known)->count >= first + count) {
+      skipped_blocks += count;
+      done_blocks += count;
+      ReportProgress(false);
+      return;
+    }
+
+    std::size_t block_size = (std::size_t)level.block_size;
+    byte_seq data(block_size * count);
+    std::size_t got =
+        level.data->ReadInto(first * block_size, data.size(), data.data());
+    byte_seq hashes =
+        level.hash->Read(first * Crypto::SHA256_DIGEST_SIZE,
+                         count * Crypto::SHA256_DIGEST_SIZE);
+
+    // blocks past the end of the data are hashed as far as they exist
+    std::vector<Crypto::Sha256Digest> digests(count);
+    std::size_t full = std::min<std::size_t>(count, got / block_size);
+    Crypto::Sha256::DigestBlocks(data.data(), block_size, full,
+                                 digests.data());
+    for (std::size_t i = full; i < count; ++i) {
+      std::size_t pos = i * block_size;
+      digests[i] = Crypto::Sha256::Digest(
+          data.data() + pos, got > pos ? std::min(block_size, got - pos) : 0);
+    }
+
+    auto &ranges = task_mismatches[task];
+    for (std::size_t i = 0; i < count; ++i) {
+      std::size_t hash_pos = i * Crypto::SHA256_DIGEST_SIZE;
+      bool match = hashes.size() >= hash_pos + Crypto::SHA256_DIGEST_SIZE &&
+                   std::memcmp(digests[i].data(), hashes.data() + hash_pos,
+                               Crypto::SHA256_DIGEST_SIZE) == 0;
+      if (match)
+        continue;
+      if (!ranges.empty() &&
+          ranges.back().first + ranges.back().count == first + i) {
+        ++ranges.back().count;
+      } else {
+        ranges.push_back({index, first + i, 1});
+      }
+    }
+
+    if (record) {
+      u64 pos = first;
+      for (const auto &range : ranges) {
+        cache.AddGoodBlocks(subject, {pos, range.first - pos});
+        pos = range.first + range.count;
+      }
+      cache.AddGoodBlocks(subject, {pos, first + count - pos});
+    }
+
+    done_blocks += count;
+    ReportProgress(false);
+  });
+
+  // join ranges that continue across task boundaries
+  for (auto &ranges : task_mismatches) {
+    for (const auto &range : ranges) {
+      if (!mismatches.empty() && mismatches.back().level == index &&
+          mismatches.back().first + mismatches.back().count == range.first) {
+        mismatches.back().count += range.count;
+      } else {
+        mismatches.push_back(range);
+      }
+    }
+  }
+}
+
+bool IvfcVerifier::Run() {
+  mismatches.clear();
+  done_blocks = 0;
+  skipped_blocks = 0;
+  canceled = false;
+
+  std::mt19937_64 random(sample_seed ? sample_seed : std::random_device()());
+  std::vector<std::vector<BlockRange>> plan;
+  planned_blocks = 0;
+  for (std::size_t i = 0; i < levels.size(); ++i) {
+    plan.push_back(PlanLevel(i, random));
+    for (const auto &task : plan.back())
+      planned_blocks += task.count;
+  }
+
+  last_progress = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < levels.size() && !canceled; ++i)
+    VerifyLevel(i, plan[i]);
+  VerificationCache::Global().Flush();
+  if (!canceled)
+    ReportProgress(true);
+  return !canceled;
+}
+
+u64 IvfcVerifier::GetTotalBlocks() const { return total_blocks; }
+
+u64 IvfcVerifier::GetCheckedBlocks() const { return done_blocks; }
+
+u64 IvfcVerifier::GetPassedBlocks() const {
+  u64 failed = 0;
+  for (const auto &range : mismatches)
+    failed += range.count;
+  return done_blocks - failed;
+}
+
+u64 IvfcVerifier::GetSkippedBlocks() const { return skipped_blocks; }
+
+const std::vector<IvfcVerifier::MismatchRange> &
+IvfcVerifier::GetMismatches() const {
+  return mismatches;
+}
+
+} // namespace CB
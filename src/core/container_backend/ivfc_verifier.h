@@ -0,0 +1,90 @@
+#pragma once
+
+#include "core/container_backend/container.h"
+#include "core/container_backend/verification_cache.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+
+namespace CB {
+
+// Verifies IVFC hash levels, such as the ones of a RomFS. Each level is split
+// into ranges of blocks that are read, hashed and compared on the thread
+// pool. Failing blocks are collected as ranges of consecutive blocks.
+class IvfcVerifier {
+public:
+  struct MismatchRange {
+    std::size_t level;
+    u64 first;
+    u64 count;
+  };
+
+  // Called with the number of blocks checked so far, at most max_rate times
+  // per second and once at the end. It may be called from any pool thread,
+  // but never concurrently. Returning false cancels the run.
+  using ProgressCallback = std::function<bool(u64 done, u64 total)>;
+
+  IvfcVerifier() = default;
+
+  // Adds Level0 to Level2 of a Romfs container
+  explicit IvfcVerifier(const ContainerPtr &romfs);
+
+  // Adds a level whose data blocks of block_size bytes are checked against
+  // the SHA-256 hashes stored back to back in hash
+  void AddLevel(FB::FilePtr data, FB::FilePtr hash, u64 block_size);
+
+  void SetProgressCallback(ProgressCallback callback, double max_rate = 30);
+
+  // Checks only a random fraction of the blocks of each level, and at least
+  // one. Progress then counts up to the number of sampled blocks. A seed of 0
+  // picks different blocks each run. Sampled blocks that pass are not
+  // recorded in the cache.
+  void SetSampling(double fraction, u64 seed = 0);
+
+  // Returns false if the run was canceled. Blocks that passed are recorded
+  // in VerificationCache::Global(), so a later run skips them, even if this
+  // one was canceled.
+  bool Run();
+
+  u64 GetTotalBlocks() const;
+  // Blocks checked (or skipped) by the last run
+  u64 GetCheckedBlocks() const;
+  u64 GetPassedBlocks() const;
+  // Blocks that passed in an earlier run and were not checked again
+  u64 GetSkippedBlocks() const;
+  const std::vector<MismatchRange> &GetMismatches() const;
+
+private:
+  struct Level {
+    FB::FilePtr data;
+    FB::FilePtr hash;
+    u64 block_size;
+    u64 count;
+  };
+
+  using BlockRange = VerificationCache::BlockRange;
+
+  // The blocks to check, split into ranges of about one task each
+  std::vector<BlockRange> PlanLevel(std::size_t index, std::mt19937_64 &random);
+  void VerifyLevel(std::size_t index, const std::vector<BlockRange> &tasks);
+  void ReportProgress(bool force);
+
+  std::vector<Level> levels;
+  std::vector<MismatchRange> mismatches;
+  u64 total_blocks = 0;
+  u64 planned_blocks = 0;
+
+  double sample_fraction = 1;
+  u64 sample_seed = 0;
+
+  ProgressCallback progress;
+  std::chrono::steady_clock::duration progress_interval;
+  std::chrono::steady_clock::time_point last_progress;
+  std::mutex progress_mutex;
+  std::atomic<u64> done_blocks{0};
+  std::atomic<u64> skipped_blocks{0};
+  std::atomic<bool> canceled{false};
+};
+
+} // namespace CB
@@ -7,6 +7,7 @@
 #include "core/container_backend/sha.h"
 #include "core/cryptopp_util.h"
 #include "core/file_backend/aes_ctr.h"
+#include "core/file_backend/cached_file.h"
 #include "core/file_backend/memory_file.h"
 #include "core/file_backend/patch_file.h"
 #include "core/secret_backend/seeddb.h"
@@ -14,174 +15,215 @@
 
 namespace CB {
 
-Ncch::Ncch(FB::FilePtr file_) : FileContainer(std::move(file_)) {
-  InstallList({
-      Field<magic_t>("Magic", 0x100),
-      Field<u32>("ContentSize", 0x104),
-      Field<u64>("PartitionId", 0x108),
-      Field<u16>("MakerCode", 0x110),
-      Field<u16>("Version", 0x112),
-      Field<u32>("SeedVerifier", 0x114),
-
-      Field<u64>("ProgramId", 0x118),
-
-      Field<std::array<char, 0x10>>("ProductCode", 0x150),
-
-      Field<u32>("ExheaderHashRegionSize", 0x180),
-
-      Field<u8>("CryptoMethod", 0x18B),
-      Field<u8>("Platform", 0x18C),
-
-      Field<u8>("ContentTypeFlags", 0x18D),
-
-      {"IsData",
-       [this]() {
-         return std::make_shared<ConstContainer>((ContentType() & 0x1) != 0);
-       }},
-      {"IsExecutable",
-       [this]() {
-         return std::make_shared<ConstContainer>((ContentType() & 0x2) != 0);
-       }},
-      {"ContentType",
-       [this]() {
-         return std::make_shared<ConstContainer>((u8)(ContentType() >> 2));
-       }},
-
-      Field<u8>("ContentType2", 0x18F),
-
-      {"IsFixedKeyCrypto",
-       [this]() {
-         return std::make_shared<ConstContainer>((ContentType2() & 0x1) != 0);
-       }},
-      {"IsNoRomfsMount",
-       [this]() {
-         return std::make_shared<ConstContainer>((ContentType2() & 0x2) != 0);
-       }},
-      {"IsNoCrypto",
-       [this]() {
-         return std::make_shared<ConstContainer>((ContentType2() & 0x4) != 0);
-       }},
-      {"IsSeedCrypto",
-       [this]() {
-         return std::make_shared<ConstContainer>((ContentType2() & 0x20) != 0);
-       }},
-
-      Field<u32>("PlainRegionOffset", 0x190),
-      Field<u32>("PlainRegionSize", 0x194),
-      Field<u32>("LogoRegionOffset", 0x198),
-      Field<u32>("LogoRegionSize", 0x19C),
-      Field<u32>("ExefsOffset", 0x1A0),
-      Field<u32>("ExefsSize", 0x1A4),
-      Field<u32>("ExefsHashRegionSize", 0x1A8),
-
-      Field<u32>("RomfsOffset", 0x1B0),
-      Field<u32>("RomfsSize", 0x1B4),
-      Field<u32>("RomfsHashRegionSize", 0x1B8),
+const ContainerHelper::HandlerTable &Ncch::Handlers() {
+  static const HandlerTable table(Join(
+      SchemaHandlers(header_schema, &Ncch::header),
+      {
+          Cached(Bind<Ncch>("IsData",
+                            [](Ncch &self) {
+                              return std::make_shared<ConstContainer>(
+                                  (self.ContentType() & 0x1) != 0);
+                            })),
+          Cached(Bind<Ncch>("IsExecutable",
+                            [](Ncch &self) {
+                              return std::make_shared<ConstContainer>(
+                                  (self.ContentType() & 0x2) != 0);
+                            })),
+          Cached(Bind<Ncch>("ContentType",
+                            [](Ncch &self) {
+                              return std::make_shared<ConstContainer>(
+                                  (u8)(self.ContentType() >> 2));
+                            })),
+
+          Cached(Bind<Ncch>("IsFixedKeyCrypto",
+                            [](Ncch &self) {
+                              return std::make_shared<ConstContainer>(
+                                  (self.ContentType2() & 0x1) != 0);
+                            })),
+          Cached(Bind<Ncch>("IsNoRomfsMount",
+                            [](Ncch &self) {
+                              return std::make_shared<ConstContainer>(
+                                  (self.ContentType2() & 0x2) != 0);
+                            })),
+          Cached(Bind<Ncch>("IsNoCrypto",
+                            [](Ncch &self) {
+                              return std::make_shared<ConstContainer>(
+                                  (self.ContentType2() & 0x4) != 0);
+                            })),
+          Cached(Bind<Ncch>("IsSeedCrypto",
+                            [](Ncch &self) {
+                              return std::make_shared<ConstContainer>(
+                                  (self.ContentType2() & 0x20) != 0);
+                            })),
+
+          Bind<Ncch>("IsForceNoCrypto",
+                     [](Ncch &self) {
+                       self.InitCrypto();
+                       return std::make_shared<ConstContainer>(
+                           self.force_no_crypto);
+                     }),
+
+          Bind<Ncch>("Signature",
+                     [](Ncch &self) {
+                       return std::make_shared<Rsa>(
+                           self.HeaderRegion(0x100, 0x100),
+                           self.HeaderRegion(0, 0x100), self.SignatureKey());
+                     }),
+          Bind<Ncch>("SignaturePatched",
+                     [](Ncch &self) {
+                       return std::make_shared<Rsa>(self.PatchedHeader(),
+                                                    self.HeaderRegion(0, 0x100),
+                                                    self.SignatureKey());
+                     }),
+      }));
+  return table;
+}
 
-  });
+// Only the header is read here. Keys, the seed and the sub-containers are
+// set up when first used, so that listing many titles stays cheap.
+Ncch::Ncch(FB::FilePtr file_) : FileContainer(std::move(file_)) {
+  SnapshotHeader(0x200);
+  header = DecodeHeader(header_schema);
+  InstallTable(Handlers());
 
-  InitSeed();
+  u32 exheader_hash_region_size =
+      std::get<header_schema.Find("ExheaderHashRegionSize")>(header);
+  if (exheader_hash_region_size) {
+    auto no_error = [this]() {
+      return Open("ExheaderError")->ValueT<std::string>().empty();
+    };
+    InstallList({
+        Cached({"ExheaderError",
+                [this]() {
+                  return std::make_shared<ConstContainer>(ExheaderError());
+                }}),
+        Cached({"Exheader",
+                [this]() {
+                  return std::make_shared<Exheader>(ExheaderFile());
+                },
+                no_error}),
+        {"ExheaderHash",
+         [this, exheader_hash_region_size]() {
+           return std::make_shared<Sha>(
+               std::make_shared<FB::SubFile>(ExheaderFile(), 0,
+                                             exheader_hash_region_size),
+               HeaderRegion(0x160, 0x20));
+         },
+         no_error},
+    });
+  }
 
-  CheckForceNoCrypto();
+  u32 exefs_size = std::get<header_schema.Find("ExefsOffset")>(header);
+  if (exefs_size) {
+    auto no_error = [this]() {
+      return Open("ExefsError")->ValueT<std::string>().empty();
+    };
+    InstallList({
+        Cached({"ExefsError",
+                [this]() {
+                  return std::make_shared<ConstContainer>(ExefsError());
+                }}),
+        Cached({"Exefs",
+                [this]() {
+                  return std::make_shared<Exefs>(PrimaryExefsFile(),
+                                                 SecondaryExefsFile());
+                },
+                no_error}),
+        {"ExefsHash",
+         [this]() {
+           u32 region_size =
+               std::get<header_schema.Find("ExefsHashRegionSize")>(header);
+           return std::make_shared<Sha>(
+               std::make_shared<FB::SubFile>(PrimaryExefsFile(), 0,
+                                             region_size * 0x200),
+               HeaderRegion(0x1C0, 0x20));
+         },
+         no_error},
+    });
+  }
 
-  InstallList({{"IsForceNoCrypto", [this]() {
-                  return std::make_shared<ConstContainer>(force_no_crypto);
-                }}});
+  u32 romfs_size = std::get<header_schema.Find("RomfsOffset")>(header);
+  if (romfs_size) {
+    auto no_error = [this]() {
+      return Open("RomfsError")->ValueT<std::string>().empty();
+    };
+    InstallList({
+        Cached({"RomfsError",
+                [this]() {
+                  return std::make_shared<ConstContainer>(RomfsError());
+                }}),
+        Cached({"Romfs",
+                [this]() { return std::make_shared<Romfs>(RomfsFile()); },
+                no_error}),
+        {"RomfsHash",
+         [this]() {
+           u32 region_size =
+               std::get<header_schema.Find("RomfsHashRegionSize")>(header);
+           return std::make_shared<Sha>(
+               std::make_shared<FB::SubFile>(RomfsFile(), 0,
+                                             region_size * 0x200),
+               HeaderRegion(0x1E0, 0x20));
+         },
+         no_error},
+    });
+  }
+}
 
-  FB::FilePtr signature_key;
+static bool Matches(const ContainerPtr &check) {
+  ContainerPtr match = check->Open("Match");
+  return match && match->ValueT<bool>();
+}
 
-  u32 exheader_hash_region_size = Open("ExheaderHashRegionSize")->ValueT<u32>();
-  if (exheader_hash_region_size) {
-    auto error = ExheaderError();
-    InstallList({{"ExheaderError", [error]() {
-                    return std::make_shared<ConstContainer>(error);
-                  }}});
-    if (error.empty()) {
-      InstallList({
-          {"Exheader",
-           [this]() { return std::make_shared<Exheader>(ExheaderFile()); }},
-          {"ExheaderHash",
-           [this, exheader_hash_region_size]() {
-             return std::make_shared<Sha>(
-                 std::make_shared<FB::SubFile>(ExheaderFile(), 0,
-                                               exheader_hash_region_size),
-                 std::make_shared<FB::SubFile>(this->file, 0x160, 0x20));
-           }},
-      });
-      signature_key = Open("Exheader")
-                          ->Open("NcchSignaturePublicKey")
-                          ->ValueT<FB::FilePtr>();
-    } else {
-      signature_key = std::make_shared<FB::MemoryFile>();
+VerificationResult Ncch::Verify(const VerificationOptions &options) {
+  VerificationResult result;
+  ContainerPtr signature = Open("Signature");
+  // decrypting tools set the no-crypto flag, which the signature covers
+  if ((ContentType2() & 0x4) != 0 && !Matches(signature))
+    signature = Open("SignaturePatched");
+  result.AddMatch("Signature", signature);
+
+  if (std::get<header_schema.Find("ExheaderHashRegionSize")>(header))
+    result.AddMatch("ExheaderHash", Open("ExheaderHash"));
+
+  if (std::get<header_schema.Find("ExefsOffset")>(header)) {
+    result.AddMatch("ExefsHash", Open("ExefsHash"));
+    ContainerPtr exefs = Open("Exefs");
+    if (options.level == VerificationLevel::Full && exefs) {
+      for (const std::string &name : exefs->List()) {
+        if (name.compare(0, 5, "Hash:") == 0)
+          result.AddMatch("Exefs/" + name, exefs->Open(name));
+      }
     }
-  } else {
-    signature_key =
-        std::make_shared<FB::MemoryFile>(secrets[SB::k_sec_pubkey_ncsd_cfa]);
   }
 
-  auto header = std::make_shared<FB::SubFile>(file, 0x100, 0x100);
-  auto patched_header = PatchedHeader();
-  auto signature = std::make_shared<FB::SubFile>(file, 0, 0x100);
-
-  InstallList(
-      {{"Signature",
-        [header, signature, signature_key]() {
-          return std::make_shared<Rsa>(header, signature, signature_key);
-        }},
-       {"SignaturePatched", [patched_header, signature, signature_key]() {
-          return std::make_shared<Rsa>(patched_header, signature,
-                                       signature_key);
-        }}});
-
-  u32 exefs_size = Open("ExefsOffset")->ValueT<u32>();
-  if (exefs_size) {
-    auto error = ExefsError();
-    InstallList({{"ExefsError", [error]() {
-                    return std::make_shared<ConstContainer>(error);
-                  }}});
-    if (error.empty()) {
-      InstallList({
-          {"Exefs",
-           [this]() {
-             return std::make_shared<Exefs>(PrimaryExefsFile(),
-                                            SecondaryExefsFile());
-           }},
-          {"ExefsHash",
-           [this]() {
-             u32 region_size = Open("ExefsHashRegionSize")->ValueT<u32>();
-             return std::make_shared<Sha>(
-                 std::make_shared<FB::SubFile>(PrimaryExefsFile(), 0,
-                                               region_size * 0x200),
-                 std::make_shared<FB::SubFile>(this->file, 0x1C0, 0x20));
-           }},
-      });
-    }
+  if (std::get<header_schema.Find("RomfsOffset")>(header)) {
+    result.AddMatch("RomfsHash", Open("RomfsHash"));
+    result.AddIvfc("RomfsHashTree", Open("Romfs"), options);
   }
+  return result;
+}
 
-  u32 romfs_size = Open("RomfsOffset")->ValueT<u32>();
-  if (romfs_size) {
-    auto error = RomfsError();
-    InstallList({{"RomfsError", [error]() {
-                    return std::make_shared<ConstContainer>(error);
-                  }}});
-    if (error.empty()) {
-      InstallList({
-          {"Romfs", [this]() { return std::make_shared<Romfs>(RomfsFile()); }},
-          {"RomfsHash",
-           [this]() {
-             u32 region_size = Open("RomfsHashRegionSize")->ValueT<u32>();
-             return std::make_shared<Sha>(
-                 std::make_shared<FB::SubFile>(RomfsFile(), 0,
-                                               region_size * 0x200),
-                 std::make_shared<FB::SubFile>(this->file, 0x1E0, 0x20));
-           }},
-      });
-    }
+void Ncch::InitCrypto() {
+  std::call_once(crypto_once, [this]() {
+    InitSeed();
+    CheckForceNoCrypto();
+  });
+}
+
+FB::FilePtr Ncch::SignatureKey() {
+  if (!std::get<header_schema.Find("ExheaderHashRegionSize")>(header)) {
+    return std::make_shared<FB::MemoryFile>(
+        secrets[SB::k_sec_pubkey_ncsd_cfa]);
   }
+  auto exheader = Open("Exheader");
+  if (!exheader) {
+    return std::make_shared<FB::MemoryFile>();
+  }
+  return exheader->Open("NcchSignaturePublicKey")->ValueT<FB::FilePtr>();
 }
 
 FB::FilePtr Ncch::PatchedHeader() {
-  auto header = std::make_shared<FB::SubFile>(file, 0x100, 0x100);
+  auto header = HeaderRegion(0x100, 0x100);
   auto content_flag2 = header->Read(0x8F, 1);
   auto patch = std::make_shared<FB::MemoryFile>(content_flag2);
   (*patch)[0] &= ~byte{0x4};
@@ -189,12 +231,12 @@ FB::FilePtr Ncch::PatchedHeader() {
 }
 
 void Ncch::InitSeed() {
-  if (!Open("IsSeedCrypto")->ValueT<bool>()) {
+  if ((ContentType2() & 0x20) == 0) {
     seed_status = SeedStatus::NoNeed;
     return;
   }
 
-  u64 program_id = Open("ProgramId")->ValueT<u64>();
+  u64 program_id = std::get<header_schema.Find("ProgramId")>(header);
   byte_seq seed = SB::g_seeddb.Get(program_id);
   if (seed.size() != 0x10) {
     seed_status = SeedStatus::NotFound;
@@ -206,7 +248,7 @@ void Ncch::InitSeed() {
   CryptoPP::SHA256().CalculateDigest(
       CryptoPPBytes(hash), CryptoPPBytes(hash_block), hash_block.size());
   hash.resize(4);
-  u32 seed_verifier = Open("SeedVerifier")->ValueT<u32>();
+  u32 seed_verifier = std::get<header_schema.Find("SeedVerifier")>(header);
 
   if (hash != ToByteSeq(seed_verifier)) {
     seed_status = SeedStatus::NotCorrect;
@@ -218,10 +260,10 @@ void Ncch::InitSeed() {
 }
 
 void Ncch::CheckForceNoCrypto() {
-  if (Open("IsNoCrypto")->ValueT<bool>())
+  if ((ContentType2() & 0x4) != 0)
     return;
 
-  if (!Open("RomfsOffset")->ValueT<u32>())
+  if (!std::get<header_schema.Find("RomfsOffset")>(header))
     return;
 
   if (RawRomfsFile()->Read<magic_t>(0) == magic_t{'I', 'V', 'F', 'C'}) {
@@ -230,11 +272,11 @@ void Ncch::CheckForceNoCrypto() {
 }
 
 FB::FilePtr Ncch::KeyY() {
-  return std::make_shared<FB::SubFile>(file, 0, 0x10);
+  return HeaderRegion(0, 0x10);
 }
 
 FB::FilePtr Ncch::PrimaryNormalKey() {
-  if (Open("IsFixedKeyCrypto")->ValueT<bool>()) {
+  if ((ContentType2() & 0x1) != 0) {
     // TODO: system fixed key
     return std::make_shared<FB::MemoryFile>(0x10, byte{0});
   }
@@ -248,12 +290,13 @@ FB::FilePtr Ncch::PrimaryNormalKey() {
 }
 
 FB::FilePtr Ncch::SecondaryNormalKey() {
-  if (Open("IsFixedKeyCrypto")->ValueT<bool>()) {
+  if ((ContentType2() & 0x1) != 0) {
     // TODO: system fixed key
     return std::make_shared<FB::MemoryFile>(0x10, byte{0});
   }
   auto key_y_buf = KeyY()->Read(0, 0x10);
 
+  InitCrypto();
   if (seed_status == SeedStatus::Found) {
     key_y_buf += seed;
     byte_seq hash(CryptoPP::SHA256::DIGESTSIZE);
@@ -266,7 +309,7 @@ FB::FilePtr Ncch::SecondaryNormalKey() {
   AESKey key_x, key_y, key_c;
   std::memcpy(key_y.data(), key_y_buf.data(), 0x10);
   std::memcpy(key_c.data(), secrets[SB::k_sec_aes_const].data(), 0x10);
-  switch (Open("CryptoMethod")->ValueT<u8>()) {
+  switch (std::get<header_schema.Find("CryptoMethod")>(header)) {
   case 0x00:
     std::memcpy(key_x.data(), secrets[SB::k_sec_key2C_x].data(), 0x10);
     break;
@@ -290,7 +333,7 @@ FB::FilePtr Ncch::SecondaryNormalKey() {
 }
 
 std::string Ncch::PrimaryNormalKeyError() {
-  if (Open("IsFixedKeyCrypto")->ValueT<bool>()) {
+  if ((ContentType2() & 0x1) != 0) {
     // TODO: system fixed key
     return "";
   }
@@ -302,11 +345,12 @@ std::string Ncch::PrimaryNormalKeyError() {
 }
 
 std::string Ncch::SecondaryNormalKeyError() {
-  if (Open("IsFixedKeyCrypto")->ValueT<bool>()) {
+  if ((ContentType2() & 0x1) != 0) {
     // TODO: system fixed key
     return "";
   }
 
+  InitCrypto();
   switch (seed_status) {
   case SeedStatus::NotCorrect:
     return "Seed Not Correct";
@@ -316,7 +360,7 @@ std::string Ncch::SecondaryNormalKeyError() {
 
   if (secrets[SB::k_sec_aes_const].size() != 16)
     return SB::k_sec_aes_const;
-  switch (Open("CryptoMethod")->ValueT<u8>()) {
+  switch (std::get<header_schema.Find("CryptoMethod")>(header)) {
   case 0x00:
     if (secrets[SB::k_sec_key2C_x].size() != 16)
       return SB::k_sec_key2C_x;
@@ -340,21 +384,22 @@ std::string Ncch::SecondaryNormalKeyError() {
 }
 
 bool Ncch::IsDecrypted() {
-  return force_no_crypto || Open("IsNoCrypto")->ValueT<bool>();
+  InitCrypto();
+  return force_no_crypto || (ContentType2() & 0x4) != 0;
 }
 
 FB::FilePtr Ncch::CryptoIv(IvType type) {
-  u16 version = Open("Version")->ValueT<u16>();
+  u16 version = std::get<header_schema.Find("Version")>(header);
   if (version == 1) {
     throw;
   }
 
-  u64 partition_id = Open("PartitionId")->ValueT<u64>();
+  u64 partition_id = std::get<header_schema.Find("PartitionId")>(header);
   std::array<byte, 8> partition_id_s;
   std::memcpy(partition_id_s.data(), &partition_id, 8);
   auto iv = std::make_shared<FB::MemoryFile>(16);
   std::reverse_copy(partition_id_s.begin(), partition_id_s.end(), iv->begin());
-  (*iv)[8] = byte{type};
+  (*iv)[8] = static_cast<byte>(type);
   return iv;
 }
 
@@ -377,18 +422,24 @@ std::string Ncch::ExheaderError() {
 
 FB::FilePtr Ncch::RawExefsFile() {
   return std::make_shared<FB::SubFile>(
-      file, Open("ExefsOffset")->ValueT<u32>() * 0x200,
-      Open("ExefsSize")->ValueT<u32>() * 0x200);
+      file, std::get<header_schema.Find("ExefsOffset")>(header) * 0x200,
+      std::get<header_schema.Find("ExefsSize")>(header) * 0x200);
 }
 
 FB::FilePtr Ncch::PrimaryExefsFile() {
-  auto raw = RawExefsFile();
   if (IsDecrypted()) {
-    return raw;
+    return RawExefsFile();
   }
 
-  auto iv = CryptoIv(IvType::Exefs);
-  return std::make_shared<FB::AesCtrFile>(raw, PrimaryNormalKey(), iv);
+  // keep one decrypted view so that all openers share its block cache
+  std::lock_guard<std::mutex> lock(file_mutex);
+  if (!primary_exefs_file) {
+    auto iv = CryptoIv(IvType::Exefs);
+    primary_exefs_file =
+        std::make_shared<FB::CachedFile>(std::make_shared<FB::AesCtrFile>(
+            RawExefsFile(), PrimaryNormalKey(), iv));
+  }
+  return primary_exefs_file;
 }
 
 FB::FilePtr Ncch::SecondaryExefsFile() {
@@ -414,19 +465,23 @@ std::string Ncch::ExefsError() {
 
 FB::FilePtr Ncch::RawRomfsFile() {
   return std::make_shared<FB::SubFile>(
-      file, Open("RomfsOffset")->ValueT<u32>() * 0x200,
-      Open("RomfsSize")->ValueT<u32>() * 0x200);
+      file, std::get<header_schema.Find("RomfsOffset")>(header) * 0x200,
+      std::get<header_schema.Find("RomfsSize")>(header) * 0x200);
 }
 
 FB::FilePtr Ncch::RomfsFile() {
-  auto raw = RawRomfsFile();
-
   if (IsDecrypted()) {
-    return raw;
+    return RawRomfsFile();
   }
 
-  auto iv = CryptoIv(IvType::Romfs);
-  return std::make_shared<FB::AesCtrFile>(raw, SecondaryNormalKey(), iv);
+  std::lock_guard<std::mutex> lock(file_mutex);
+  if (!romfs_file) {
+    auto iv = CryptoIv(IvType::Romfs);
+    romfs_file =
+        std::make_shared<FB::CachedFile>(std::make_shared<FB::AesCtrFile>(
+            RawRomfsFile(), SecondaryNormalKey(), iv));
+  }
+  return romfs_file;
 }
 
 std::string Ncch::RomfsError() {
@@ -436,8 +491,12 @@ std::string Ncch::RomfsError() {
   return SecondaryNormalKeyError();
 }
 
-u8 Ncch::ContentType() { return Open("ContentTypeFlags")->ValueT<u8>(); }
+u8 Ncch::ContentType() {
+  return std::get<header_schema.Find("ContentTypeFlags")>(header);
+}
 
-u8 Ncch::ContentType2() { return Open("ContentType2")->ValueT<u8>(); }
+u8 Ncch::ContentType2() {
+  return std::get<header_schema.Find("ContentType2")>(header);
+}
 
 } // namespace CB
\ No newline at end of file
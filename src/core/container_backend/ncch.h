@@ -1,7 +1,10 @@
 #pragma once
 
 #include "core/container_backend/container.h"
+#include "core/container_backend/schema.h"
+#include "core/container_backend/verification.h"
 #include "core/secret_backend/secret_database.h"
+#include <mutex>
 
 namespace CB {
 
@@ -9,7 +12,38 @@ class Ncch : public FileContainer {
 public:
   Ncch(FB::FilePtr file);
 
+  VerificationResult Verify(const VerificationOptions &options);
+
 private:
+  static const HandlerTable &Handlers();
+
+  static constexpr Schema header_schema{
+      Member<magic_t>("Magic", 0x100),
+      Member<u32>("ContentSize", 0x104),
+      Member<u64>("PartitionId", 0x108),
+      Member<u16>("MakerCode", 0x110),
+      Member<u16>("Version", 0x112),
+      Member<u32>("SeedVerifier", 0x114),
+      Member<u64>("ProgramId", 0x118),
+      Member<std::array<char, 0x10>>("ProductCode", 0x150),
+      Member<u32>("ExheaderHashRegionSize", 0x180),
+      Member<u8>("CryptoMethod", 0x18B),
+      Member<u8>("Platform", 0x18C),
+      Member<u8>("ContentTypeFlags", 0x18D),
+      Member<u8>("ContentType2", 0x18F),
+      Member<u32>("PlainRegionOffset", 0x190),
+      Member<u32>("PlainRegionSize", 0x194),
+      Member<u32>("LogoRegionOffset", 0x198),
+      Member<u32>("LogoRegionSize", 0x19C),
+      Member<u32>("ExefsOffset", 0x1A0),
+      Member<u32>("ExefsSize", 0x1A4),
+      Member<u32>("ExefsHashRegionSize", 0x1A8),
+      Member<u32>("RomfsOffset", 0x1B0),
+      Member<u32>("RomfsSize", 0x1B4),
+      Member<u32>("RomfsHashRegionSize", 0x1B8),
+  };
+  decltype(header_schema)::Record header;
+
   SB::SecretContext secrets;
 
   enum class SeedStatus {
@@ -23,6 +57,10 @@ private:
   void CheckForceNoCrypto();
   bool force_no_crypto = false;
 
+  // runs InitSeed and CheckForceNoCrypto once, on first use
+  void InitCrypto();
+  std::once_flag crypto_once;
+
   enum class IvType : u8 {
     Exheader = 1,
     Exefs = 2,
@@ -30,6 +68,7 @@ private:
   };
 
   FB::FilePtr PatchedHeader();
+  FB::FilePtr SignatureKey();
 
   bool IsDecrypted();
   void InitSeed();
@@ -39,6 +78,11 @@ private:
   std::string PrimaryNormalKeyError();
   std::string SecondaryNormalKeyError();
 
+  // decrypted views shared by all children, created on first use
+  std::mutex file_mutex;
+  FB::FilePtr primary_exefs_file;
+  FB::FilePtr romfs_file;
+
   FB::FilePtr CryptoIv(IvType type);
   FB::FilePtr ExheaderFile();
   std::string ExheaderError();
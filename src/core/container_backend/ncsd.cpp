@@ -5,41 +5,61 @@
 
 namespace CB {
 
+const ContainerHelper::HandlerTable &Ncsd::Handlers() {
+  static const HandlerTable table(Join(
+      {
+          Bind<Ncsd>("Signature",
+                     [](Ncsd &self) {
+                       return std::make_shared<Rsa>(
+                           self.HeaderRegion(0x100, 0x100),
+                           self.HeaderRegion(0, 0x100),
+                           std::make_shared<FB::MemoryFile>(
+                               self.secrets[SB::k_sec_pubkey_ncsd_cfa]));
+                     }),
+      },
+      SchemaHandlers(header_schema, &Ncsd::header)));
+  return table;
+}
+
 Ncsd::Ncsd(FB::FilePtr file) : FileContainer(std::move(file)) {
-  auto signature_key = secrets[SB::k_sec_pubkey_ncsd_cfa];
-  InstallList({
-      {"Signature",
-       [this, signature_key]() {
-         return std::make_shared<Rsa>(
-             std::make_shared<FB::SubFile>(this->file, 0x100, 0x100),
-             std::make_shared<FB::SubFile>(this->file, 0, 0x100),
-             std::make_shared<FB::MemoryFile>(signature_key));
-       }},
+  SnapshotHeader(0x200);
+  header = DecodeHeader(header_schema);
+  partitions = DecodeTable(partition_schema, 0x120, 8, 8);
+  InstallTable(Handlers());
 
-      Field<magic_t>("Magic", 0x100),
-      Field<u32>("ImageSize", 0x104),
-      Field<u64>("MediaId", 0x108),
-      // skip some
+  InstallArrays(SchemaArrays(partition_schema, partitions));
+  InstallArrays({
+      {"Partition", partitions.size(),
+       [this](std::size_t i) {
+         u32 offset = std::get<partition_schema.Find("PartitionOffset")>(
+             partitions[i]);
+         u32 size =
+             std::get<partition_schema.Find("PartitionSize")>(partitions[i]);
+         return std::make_shared<Ncch>(std::make_shared<FB::SubFile>(
+             this->file, offset * 0x200, size * 0x200));
+       },
+       [this](std::size_t i) {
+         return std::get<partition_schema.Find("PartitionOffset")>(
+                    partitions[i]) != 0 &&
+                std::get<partition_schema.Find("PartitionSize")>(
+                    partitions[i]) != 0;
+       },
+       true},
   });
+}
 
-  for (std::size_t i = 0; i < 8; ++i) {
-    InstallList({
-        Field<u32>(WithIndex("PartitionOffset", i), 0x120 + i * 8),
-        Field<u32>(WithIndex("PartitionSize", i), 0x124 + i * 8),
-    });
-    u32 offset = Open(WithIndex("PartitionOffset", i))->ValueT<u32>();
-    u32 size = Open(WithIndex("PartitionSize", i))->ValueT<u32>();
-    if (offset && size) {
-      auto partition_opener = [this, offset, size]() {
-        return std::make_shared<Ncch>(std::make_shared<FB::SubFile>(
-            this->file, offset * 0x200, size * 0x200));
-
-      };
-      InstallList({
-          {WithIndex("Partition", i), partition_opener},
-      });
+VerificationResult Ncsd::Verify(const VerificationOptions &options) {
+  VerificationResult result;
+  result.AddMatch("Signature", Open("Signature"));
+  for (std::size_t i = 0; i < partitions.size(); ++i) {
+    // Partition always makes an Ncch
+    auto partition = std::static_pointer_cast<Ncch>(OpenAt("Partition", i));
+    if (partition) {
+      result.Merge("Partition" + std::to_string(i) + "/",
+                   partition->Verify(options));
     }
   }
+  return result;
 }
 
-} // namespace CB
\ No newline at end of file
+} // namespace CB
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "core/container_backend/container.h"
+#include "core/container_backend/schema.h"
+#include "core/container_backend/verification.h"
 #include "core/secret_backend/secret_database.h"
 
 namespace CB {
@@ -9,7 +11,26 @@ class Ncsd : public FileContainer {
 public:
   Ncsd(FB::FilePtr file);
 
+  VerificationResult Verify(const VerificationOptions &options);
+
 private:
+  static const HandlerTable &Handlers();
+
+  static constexpr Schema header_schema{
+      Member<magic_t>("Magic", 0x100),
+      Member<u32>("ImageSize", 0x104),
+      Member<u64>("MediaId", 0x108),
+      // skip some
+  };
+  decltype(header_schema)::Record header;
+
+  // eight entries, 8 bytes apart from 0x120
+  static constexpr Schema partition_schema{
+      Member<u32>("PartitionOffset", 0x0),
+      Member<u32>("PartitionSize", 0x4),
+  };
+  std::vector<decltype(partition_schema)::Record> partitions;
+
   SB::SecretContext secrets;
 };
 
@@ -1,122 +1,235 @@
 #include "core/container_backend/romfs.h"
 #include "core/align.h"
+#include "core/container_backend/ivfc_verifier.h"
+#include "core/container_backend/romfs_index.h"
 #include "core/container_backend/sha.h"
+#include "core/file_backend/ivfc_verified_file.h"
+#include "core/string_util.h"
 
 namespace CB {
 
-class Level3Cursor : public ContainerHelper {
-  struct DirectoryEntry {
-    u32 parent;
-    u32 sibling_directory;
-    u32 child_directory;
-    u32 child_file;
-    u32 next_collision;
-  };
-  struct FileEntry {
-    u32 parent;
-    u32 sibling_file;
-    u64 data_offset;
-    u64 data_size;
-    u32 next_collision;
-  };
+struct DirectoryEntry {
+  u32 parent;
+  u32 sibling_directory;
+  u32 child_directory;
+  u32 child_file;
+  u32 next_collision;
+};
 
-  static std::string ReadName(FB::FilePtr file, u32 offset) {
-    u32 length = file->Read<u32>(offset);
-    auto str = file->Read(offset + 4, length);
-    std::string result;
-    // HACK
-    for (auto iter = str.begin(); iter != str.end(); iter += 2) {
-      result += (char)*iter;
-    }
-    return result;
+struct FileEntry {
+  u32 parent;
+  u32 sibling_file;
+  u64 data_offset;
+  u64 data_size;
+  u32 next_collision;
+};
+
+// Names follow the entries, as a u32 byte length and UTF-16 characters
+constexpr u32 k_directory_name_offset = 0x14;
+constexpr u32 k_file_name_offset = 0x1C;
+constexpr u32 k_no_entry = 0xFFFFFFFF;
+
+// Compares the name at offset with name. The stored length is checked first,
+// so a damaged one can't make us read or allocate much.
+static bool NameEquals(const FB::FilePtr &file, u32 offset,
+                       const std::u16string &name) {
+  u64 file_size = file->GetSize();
+  if ((u64)offset + 4 > file_size)
+    return false;
+  u32 length = file->Read<u32>(offset);
+  if (length != name.size() * 2 || (u64)offset + 4 + length > file_size)
+    return false;
+  std::u16string stored(name.size(), u'\0');
+  file->ReadInto(offset + 4, length, reinterpret_cast<byte *>(&stored[0]));
+  return stored == name;
+}
+
+// The hash that places an entry in its hash table bucket
+static u32 NameHash(u32 parent, const std::u16string &name) {
+  u32 hash = parent ^ 123456789;
+  for (char16_t c : name) {
+    hash = (hash >> 5) | (hash << 27);
+    hash ^= c;
   }
+  return hash;
+}
 
+class Level3Cursor : public ContainerHelper {
 public:
-  Level3Cursor(FB::FilePtr directory_metadata_, FB::FilePtr file_metadata_,
-               FB::FilePtr file_data_, u32 directory_offset)
-      : directory_metadata(std::move(directory_metadata_)),
-        file_metadata(std::move(file_metadata_)),
-        file_data(std::move(file_data_)) {
-    auto self = directory_metadata->Read<DirectoryEntry>(directory_offset);
-
-    u32 child_offset = self.child_directory;
-    while (child_offset != 0xFFFFFFFF) {
-      auto child = directory_metadata->Read<DirectoryEntry>(child_offset);
-      std::string name = ReadName(directory_metadata, child_offset + 0x14);
-      InstallList({{name, [this, child_offset]() {
-                      return std::make_shared<Level3Cursor>(
-                          directory_metadata, file_metadata, file_data,
-                          child_offset);
+  Level3Cursor(std::shared_ptr<const RomfsIndex> index_,
+               FB::FilePtr file_data_, u32 directory)
+      : index(std::move(index_)), file_data(std::move(file_data_)) {
+    // a directory that does not exist, for example the root of an empty
+    // index, has no children. The counts stop loops in damaged metadata.
+    u32 child = index->FirstChildDirectory(directory);
+    for (std::size_t n = 0;
+         child != RomfsIndex::k_none && n < index->DirectoryCount(); ++n) {
+      InstallList({{std::string(index->DirectoryName(child)),
+                    [this, child]() {
+                      return std::make_shared<Level3Cursor>(index, file_data,
+                                                            child);
                     }}});
-      child_offset = child.sibling_directory;
+      child = index->NextDirectory(child);
     }
 
-    child_offset = self.child_file;
-    while (child_offset != 0xFFFFFFFF) {
-      auto child = file_metadata->Read<FileEntry>(child_offset);
-      std::string name = ReadName(file_metadata, child_offset + 0x1C);
-      u64 offset = child.data_offset;
-      u64 size = child.data_size;
-      InstallList(
-          {{name, [this, offset, size]() {
-              return std::make_shared<FileContainer>(
-                  std::make_shared<FB::SubFile>(file_data, offset, size));
-            }}});
-      child_offset = child.sibling_file;
+    child = index->FirstChildFile(directory);
+    for (std::size_t n = 0;
+         child != RomfsIndex::k_none && n < index->FileCount(); ++n) {
+      InstallList({{std::string(index->FileName(child)), [this, child]() {
+                      return std::make_shared<FileContainer>(
+                          std::make_shared<FB::SubFile>(
+                              file_data, index->FileDataOffset(child),
+                              index->FileDataSize(child)));
+                    }}});
+      child = index->NextFile(child);
     }
   }
 
 private:
-  FB::FilePtr directory_metadata;
-  FB::FilePtr file_metadata;
+  std::shared_ptr<const RomfsIndex> index;
   FB::FilePtr file_data;
 };
 
 class Level3 : public FileContainer {
 public:
   Level3(FB::FilePtr file_) : FileContainer(std::move(file_)) {
-    InstallList({Field<u32>("DirectoryHashTableOffset", 0x4),
-                 Field<u32>("DirectoryHashTableSize", 0x8),
-                 Field<u32>("DirectoryMetadataOffset", 0xC),
-                 Field<u32>("DirectoryMetadataSize", 0x10),
-                 Field<u32>("FileHashTableOffset", 0x14),
-                 Field<u32>("FileHashTableSize", 0x18),
-                 Field<u32>("FileMetadataOffset", 0x1C),
-                 Field<u32>("FileMetadataSize", 0x20),
-                 Field<u32>("FileDataOffset", 0x24),
-                 {".", [this]() {
-                    return std::make_shared<Level3Cursor>(
-                        DirectoryMetadata(), FileMetadata(), FileData(), 0);
-                  }}});
+    header = DecodeHeader(header_schema);
+    InstallTable(Handlers());
+  }
+
+  ContainerPtr OpenPath(const std::string &path) {
+    std::vector<std::u16string> components;
+    std::size_t begin = 0;
+    while (begin <= path.size()) {
+      std::size_t end = std::min(path.find('/', begin), path.size());
+      if (end != begin)
+        components.push_back(Utf8ToUtf16(path.substr(begin, end - begin)));
+      begin = end + 1;
+    }
+
+    auto directory_hash_table = DirectoryHashTable();
+    auto directory_metadata = DirectoryMetadata();
+    auto file_hash_table = FileHashTable();
+    auto file_metadata = FileMetadata();
+    auto file_data = FileData();
+    u32 directory = 0;
+    for (std::size_t i = 0; i < components.size(); ++i) {
+      if (i + 1 == components.size()) {
+        u32 file_offset =
+            FindEntry<FileEntry>(file_hash_table, file_metadata,
+                                 k_file_name_offset, directory, components[i]);
+        if (file_offset != k_no_entry) {
+          auto entry = file_metadata->Read<FileEntry>(file_offset);
+          return std::make_shared<FileContainer>(std::make_shared<FB::SubFile>(
+              file_data, entry.data_offset, entry.data_size));
+        }
+      }
+      directory = FindEntry<DirectoryEntry>(
+          directory_hash_table, directory_metadata, k_directory_name_offset,
+          directory, components[i]);
+      if (directory == k_no_entry)
+        return nullptr;
+    }
+    return std::make_shared<Level3Cursor>(
+        Index(), file_data, Index()->DirectoryAt(directory));
   }
 
 private:
+  static const HandlerTable &Handlers() {
+    static const HandlerTable table(Join(
+        SchemaHandlers(header_schema, &Level3::header),
+        {
+            Cached(Bind<Level3>(".",
+                                [](Level3 &self) {
+                                  return std::make_shared<Level3Cursor>(
+                                      self.Index(), self.FileData(), 0);
+                                })),
+            Bind<Level3>("IndexMemoryUsage",
+                         [](Level3 &self) {
+                           return std::make_shared<ConstContainer>(
+                               u64(self.Index()->MemoryUsage()));
+                         }),
+        }));
+    return table;
+  }
+
+  static constexpr Schema header_schema{
+      Member<u32>("DirectoryHashTableOffset", 0x4),
+      Member<u32>("DirectoryHashTableSize", 0x8),
+      Member<u32>("DirectoryMetadataOffset", 0xC),
+      Member<u32>("DirectoryMetadataSize", 0x10),
+      Member<u32>("FileHashTableOffset", 0x14),
+      Member<u32>("FileHashTableSize", 0x18),
+      Member<u32>("FileMetadataOffset", 0x1C),
+      Member<u32>("FileMetadataSize", 0x20),
+      Member<u32>("FileDataOffset", 0x24),
+  };
+  decltype(header_schema)::Record header;
+
+  // Built on first use, with one read of each metadata table
+  std::once_flag index_once;
+  std::shared_ptr<const RomfsIndex> index;
+
+  std::shared_ptr<const RomfsIndex> Index() {
+    std::call_once(index_once, [this]() {
+      index = std::make_shared<RomfsIndex>(DirectoryMetadata(), FileMetadata());
+    });
+    return index;
+  }
+
+  template <std::size_t offset, std::size_t size> FB::FilePtr Region() {
+    return std::make_shared<FB::SubFile>(file, std::get<offset>(header),
+                                         std::get<size>(header));
+  }
+
   FB::FilePtr DirectoryHashTable() {
-    return std::make_shared<FB::SubFile>(
-        file, Open("DirectoryHashTableOffset")->ValueT<u32>(),
-        Open("DirectoryHashTableSize")->ValueT<u32>());
+    return Region<header_schema.Find("DirectoryHashTableOffset"),
+                  header_schema.Find("DirectoryHashTableSize")>();
   }
   FB::FilePtr DirectoryMetadata() {
-    return std::make_shared<FB::SubFile>(
-        file, Open("DirectoryMetadataOffset")->ValueT<u32>(),
-        Open("DirectoryMetadataSize")->ValueT<u32>());
+    return Region<header_schema.Find("DirectoryMetadataOffset"),
+                  header_schema.Find("DirectoryMetadataSize")>();
   }
   FB::FilePtr FileHashTable() {
-    return std::make_shared<FB::SubFile>(
-        file, Open("FileHashTableOffset")->ValueT<u32>(),
-        Open("FileHashTableSize")->ValueT<u32>());
+    return Region<header_schema.Find("FileHashTableOffset"),
+                  header_schema.Find("FileHashTableSize")>();
   }
   FB::FilePtr FileMetadata() {
-    return std::make_shared<FB::SubFile>(
-        file, Open("FileMetadataOffset")->ValueT<u32>(),
-        Open("FileMetadataSize")->ValueT<u32>());
+    return Region<header_schema.Find("FileMetadataOffset"),
+                  header_schema.Find("FileMetadataSize")>();
   }
 
   FB::FilePtr FileData() {
-    u32 offset = Open("FileDataOffset")->ValueT<u32>();
+    u32 offset = std::get<header_schema.Find("FileDataOffset")>(header);
     std::size_t size = file->GetSize() - offset;
     return std::make_shared<FB::SubFile>(file, offset, size);
   }
+
+  // Walks the collision chain of the bucket for name under parent. Returns
+  // the offset of the entry in metadata, or k_no_entry. The chain is cut
+  // short where damaged metadata makes it leave the metadata or loop.
+  template <typename Entry>
+  static u32 FindEntry(const FB::FilePtr &hash_table,
+                       const FB::FilePtr &metadata, u32 name_offset,
+                       u32 parent, const std::u16string &name) {
+    std::size_t bucket_count = hash_table->GetSize() / 4;
+    if (bucket_count == 0)
+      return k_no_entry;
+    std::size_t bucket = NameHash(parent, name) % bucket_count;
+    u64 metadata_size = metadata->GetSize();
+    u32 offset = hash_table->Read<u32>(bucket * 4);
+    for (u64 steps = metadata_size / sizeof(Entry);
+         offset != k_no_entry && steps != 0; --steps) {
+      if ((u64)offset + sizeof(Entry) > metadata_size)
+        return k_no_entry;
+      auto entry = metadata->Read<Entry>(offset);
+      if (entry.parent == parent &&
+          NameEquals(metadata, offset + name_offset, name))
+        return offset;
+      offset = entry.next_collision;
+    }
+    return k_no_entry;
+  }
 };
 
 class ShaList : public ContainerHelper {
@@ -129,24 +242,31 @@ public:
     }
     InstallList({
         {"Size", [size]() { return std::make_shared<ConstContainer>(size); }},
+        {"BlockSize",
+         [block_size]() {
+           return std::make_shared<ConstContainer>(u64(block_size));
+         }},
+        {"Data",
+         [this]() { return std::make_shared<FileContainer>(data); }},
+        {"HashData",
+         [this]() { return std::make_shared<FileContainer>(hash); }},
     });
-    for (u64 i = 0; i < size; ++i) {
-      InstallList({{WithIndex("Hash", i), [i, block_size, this]() {
+    InstallArrays({{"Hash", (std::size_t)size,
+                    [block_size, this](std::size_t i) {
                       return std::make_shared<Sha>(
                           std::make_shared<FB::SubFile>(data, i * block_size,
                                                         block_size),
                           std::make_shared<FB::SubFile>(hash, i * 0x20, 0x20));
                     }}});
-    }
 
     InstallList(
-        {{"Match", [this, size]() {
-            for (u64 i = 0; i < size; ++i) {
-              if (!Open(WithIndex("Hash", i))->Open("Match")->ValueT<bool>()) {
-                return std::make_shared<ConstContainer>(false);
-              }
-            }
-            return std::make_shared<ConstContainer>(true);
+        {{"Match", [this, block_size]() {
+            // verify all blocks at once rather than one Sha per block
+            IvfcVerifier verifier;
+            verifier.AddLevel(data, hash, block_size);
+            verifier.Run();
+            return std::make_shared<ConstContainer>(
+                verifier.GetMismatches().empty());
           }}});
   }
 
@@ -155,91 +275,102 @@ private:
   FB::FilePtr hash;
 };
 
+const ContainerHelper::HandlerTable &Romfs::Handlers() {
+  static const HandlerTable table(
+      SchemaHandlers(header_schema, &Romfs::header));
+  return table;
+}
+
 Romfs::Romfs(FB::FilePtr file_) : FileContainer(std::move(file_)) {
+  SnapshotHeader(0x60);
+  header = DecodeHeader(header_schema);
+  levels = DecodeTable(level_schema, 0x0C, 0x18, 3);
+  InstallTable(Handlers());
   InstallList({
-      Field<u32>("Level0Size", 0x08),
-
-      Field<u64>("Level1Offset", 0x0C),
-      Field<u64>("Level1Size", 0x14),
       {"Level1BlockSize",
        [this]() {
-         return std::make_shared<ConstContainer>(u64(1)
-                                                 << file->Read<u32>(0x1C));
+         return std::make_shared<ConstContainer>(LevelBlockSize(1));
        }},
-
-      Field<u64>("Level2Offset", 0x24),
-      Field<u64>("Level2Size", 0x2C),
       {"Level2BlockSize",
        [this]() {
-         return std::make_shared<ConstContainer>(u64(1)
-                                                 << file->Read<u32>(0x34));
+         return std::make_shared<ConstContainer>(LevelBlockSize(2));
        }},
-
-      Field<u64>("Level3Offset", 0x3C),
-      Field<u64>("Level3Size", 0x44),
       {"Level3BlockSize",
        [this]() {
-         return std::make_shared<ConstContainer>(u64(1)
-                                                 << file->Read<u32>(0x4C));
+         return std::make_shared<ConstContainer>(LevelBlockSize(3));
        }},
-
       {"Level0",
        [this]() {
-         return std::make_shared<ShaList>(
-             Level1File(true), Level0File(),
-             Open("Level1BlockSize")->ValueT<u64>());
+         return std::make_shared<ShaList>(Level1File(true), Level0File(),
+                                          LevelBlockSize(1));
        }},
       {"Level1",
        [this]() {
-         return std::make_shared<ShaList>(
-             Level2File(true), Level1File(false),
-             Open("Level2BlockSize")->ValueT<u64>());
+         return std::make_shared<ShaList>(Level2File(true), Level1File(false),
+                                          LevelBlockSize(2));
        }},
       {"Level2",
        [this]() {
-         return std::make_shared<ShaList>(
-             Level3File(true), Level2File(false),
-             Open("Level3BlockSize")->ValueT<u64>());
+         return std::make_shared<ShaList>(Level3File(true), Level2File(false),
+                                          LevelBlockSize(3));
        }},
-      {"Level3",
-       [this]() { return std::make_shared<Level3>(Level3File(false)); }},
+      Cached({"Level3",
+              [this]() {
+                return std::make_shared<Level3>(Level3File(false));
+              }}),
+      Cached({"VerifiedLevel3",
+              [this]() {
+                return std::make_shared<Level3>(VerifiedLevel3File());
+              }}),
   });
 }
 
+u64 Romfs::LevelSize(std::size_t level, bool align_up) const {
+  u64 size = std::get<level_schema.Find("Size")>(levels[level - 1]);
+  return align_up ? AlignUp(size, LevelBlockSize(level)) : size;
+}
+
+u64 Romfs::LevelBlockSize(std::size_t level) const {
+  return u64(1) << std::get<level_schema.Find("BlockShift")>(levels[level - 1]);
+}
+
+ContainerPtr Romfs::OpenPath(const std::string &path) {
+  return std::static_pointer_cast<Level3>(Open("Level3"))->OpenPath(path);
+}
+
 FB::FilePtr Romfs::Level0File() {
-  u32 size = Open("Level0Size")->ValueT<u32>();
+  u32 size = std::get<header_schema.Find("Level0Size")>(header);
   return std::make_shared<FB::SubFile>(file, 0x60, size);
 }
 
-FB::FilePtr Romfs::Level1Or2File(const std::string &number, bool align_up) {
-  u64 l3_size = Open("Level3Size")->ValueT<u64>();
-  u64 l3_block_size = Open("Level3BlockSize")->ValueT<u64>();
-  l3_size = AlignUp(l3_size, l3_block_size);
-
-  u64 size = Open("Level" + number + "Size")->ValueT<u64>();
-  if (align_up) {
-    u64 block_size = Open("Level" + number + "BlockSize")->ValueT<u64>();
-    size = AlignUp(size, block_size);
-  }
-  u64 offset = Open("Level" + number + "Offset")->ValueT<u64>();
-  return std::make_shared<FB::SubFile>(file, 0x1000 + l3_size + offset, size);
+FB::FilePtr Romfs::Level1Or2File(std::size_t level, bool align_up) {
+  u64 offset = std::get<level_schema.Find("Offset")>(levels[level - 1]);
+  offset += 0x1000 + LevelSize(3, true);
+  u64 size = LevelSize(level, align_up);
+  return std::make_shared<FB::SubFile>(file, offset, size);
 }
 
 FB::FilePtr Romfs::Level1File(bool align_up) {
-  return Level1Or2File("1", align_up);
+  return Level1Or2File(1, align_up);
 }
 
 FB::FilePtr Romfs::Level2File(bool align_up) {
-  return Level1Or2File("2", align_up);
+  return Level1Or2File(2, align_up);
 }
 
 FB::FilePtr Romfs::Level3File(bool align_up) {
-  u64 size = Open("Level3Size")->ValueT<u64>();
-  if (align_up) {
-    u64 block_size = Open("Level3BlockSize")->ValueT<u64>();
-    size = AlignUp(size, block_size);
-  }
-  return std::make_shared<FB::SubFile>(file, 0x1000, size);
+  return std::make_shared<FB::SubFile>(file, 0x1000, LevelSize(3, align_up));
+}
+
+FB::FilePtr Romfs::VerifiedLevel3File() {
+  // Level 0 is the master hash, which the NCCH header vouches for
+  std::vector<FB::IvfcVerifiedFile::Level> levels{
+      {Level1File(true), (std::size_t)LevelBlockSize(1)},
+      {Level2File(true), (std::size_t)LevelBlockSize(2)},
+      {Level3File(true), (std::size_t)LevelBlockSize(3)},
+  };
+  return std::make_shared<FB::IvfcVerifiedFile>(
+      Level0File(), std::move(levels), LevelSize(3, false));
 }
 
-} // namespace CB
\ No newline at end of file
+} // namespace CB
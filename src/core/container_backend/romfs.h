@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core/container_backend/container.h"
+#include "core/container_backend/schema.h"
 
 namespace CB {
 
@@ -8,12 +9,44 @@ class Romfs : public FileContainer {
 public:
   Romfs(FB::FilePtr file_);
 
+  // The file or directory at path (such as "a/b/c.bin"), found through the
+  // Level 3 hash tables without listing directories. Returns nullptr if
+  // there is none.
+  ContainerPtr OpenPath(const std::string &path);
+
 private:
+  static const HandlerTable &Handlers();
+
+  static constexpr Schema header_schema{
+      Member<u32>("Level0Size", 0x08),
+      Member<u64>("Level1Offset", 0x0C),
+      Member<u64>("Level1Size", 0x14),
+      Member<u64>("Level2Offset", 0x24),
+      Member<u64>("Level2Size", 0x2C),
+      Member<u64>("Level3Offset", 0x3C),
+      Member<u64>("Level3Size", 0x44),
+  };
+  decltype(header_schema)::Record header;
+
+  // Levels 1 to 3 are described by the same record, 0x18 bytes apart
+  static constexpr Schema level_schema{
+      Member<u64>("Offset", 0x0),
+      Member<u64>("Size", 0x8),
+      Member<u32>("BlockShift", 0x10),
+  };
+  std::vector<decltype(level_schema)::Record> levels;
+
+  u64 LevelSize(std::size_t level, bool align_up) const;
+  u64 LevelBlockSize(std::size_t level) const;
+
   FB::FilePtr Level0File();
-  FB::FilePtr Level1Or2File(const std::string &number, bool align_up);
+  FB::FilePtr Level1Or2File(std::size_t level, bool align_up);
   FB::FilePtr Level1File(bool align_up);
   FB::FilePtr Level2File(bool align_up);
   FB::FilePtr Level3File(bool align_up);
+
+  // Level 3 with every block checked against the hash levels as it is read
+  FB::FilePtr VerifiedLevel3File();
 };
 
 } // namespace CB
\ No newline at end of file
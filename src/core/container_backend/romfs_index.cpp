@@ -0,0 +1,190 @@
+#include "core/container_backend/romfs_index.h"
+#include "core/align.h"
+#include "core/string_util.h"
+#include <algorithm>
+
+namespace CB {
+
+// Entry layouts. The name follows the fixed fields, as a u32 byte size and
+// UTF-16 characters padded to 4 bytes.
+constexpr std::size_t k_directory_entry_size = 0x18;
+constexpr std::size_t k_file_entry_size = 0x20;
+
+static u32 Load32(const byte *data) {
+  u32 value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static u64 Load64(const byte *data) {
+  u64 value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// The number of the entry at offset, given the sorted entry offsets
+static u32 EntryAt(const std::vector<u32> &offsets, u32 offset) {
+  auto found = std::lower_bound(offsets.begin(), offsets.end(), offset);
+  if (found == offsets.end() || *found != offset)
+    return RomfsIndex::k_none;
+  return (u32)(found - offsets.begin());
+}
+
+// Turns the metadata offsets in links into entry numbers
+static void Link(std::vector<u32> &links, const std::vector<u32> &offsets) {
+  for (u32 &link : links)
+    link = EntryAt(offsets, link);
+}
+
+// The link of an entry, or k_none for an entry that does not exist
+static u32 LinkOf(const std::vector<u32> &links, u32 entry) {
+  return entry < links.size() ? links[entry] : RomfsIndex::k_none;
+}
+
+template <typename T>
+static std::size_t VectorMemory(const std::vector<T> &vector) {
+  return vector.capacity() * sizeof(T);
+}
+
+RomfsIndex::RomfsIndex(const FB::FilePtr &directory_metadata,
+                       const FB::FilePtr &file_metadata) {
+  byte_seq data = directory_metadata->Read(0, directory_metadata->GetSize());
+  for (std::size_t pos = 0; pos + k_directory_entry_size <= data.size();) {
+    const byte *entry = data.data() + pos;
+    u32 name_size = Load32(entry + 0x14);
+    if (name_size > data.size() - pos - k_directory_entry_size)
+      break;
+    directories.metadata_offset.push_back((u32)pos);
+    directories.parent.push_back(Load32(entry));
+    directories.sibling.push_back(Load32(entry + 0x4));
+    directories.child_directory.push_back(Load32(entry + 0x8));
+    directories.child_file.push_back(Load32(entry + 0xC));
+    AddName(directories.names, entry + k_directory_entry_size, name_size);
+    pos += k_directory_entry_size + AlignUp(name_size, 4);
+  }
+
+  data = file_metadata->Read(0, file_metadata->GetSize());
+  for (std::size_t pos = 0; pos + k_file_entry_size <= data.size();) {
+    const byte *entry = data.data() + pos;
+    u32 name_size = Load32(entry + 0x1C);
+    if (name_size > data.size() - pos - k_file_entry_size)
+      break;
+    files.metadata_offset.push_back((u32)pos);
+    files.parent.push_back(Load32(entry));
+    files.sibling.push_back(Load32(entry + 0x4));
+    files.data_offset.push_back(Load64(entry + 0x8));
+    files.data_size.push_back(Load64(entry + 0x10));
+    AddName(files.names, entry + k_file_entry_size, name_size);
+    pos += k_file_entry_size + AlignUp(name_size, 4);
+  }
+
+  Link(directories.parent, directories.metadata_offset);
+  Link(directories.sibling, directories.metadata_offset);
+  Link(directories.child_directory, directories.metadata_offset);
+  Link(directories.child_file, files.metadata_offset);
+  Link(files.parent, directories.metadata_offset);
+  Link(files.sibling, files.metadata_offset);
+
+  // the tables were read in one piece, so the entry count is only known now
+  for (auto *vector :
+       {&directories.metadata_offset, &directories.names.offset,
+        &directories.names.size, &directories.parent, &directories.sibling,
+        &directories.child_directory, &directories.child_file,
+        &files.metadata_offset, &files.names.offset, &files.names.size,
+        &files.parent, &files.sibling})
+    vector->shrink_to_fit();
+  files.data_offset.shrink_to_fit();
+  files.data_size.shrink_to_fit();
+  pool.shrink_to_fit();
+}
+
+void RomfsIndex::AddName(Names &names, const byte *data, u32 size) {
+  names.offset.push_back((u32)pool.size());
+  std::u16string name(size / 2, u'\0');
+  std::memcpy(&name[0], data, name.size() * 2);
+  if (std::all_of(name.begin(), name.end(),
+                  [](char16_t c) { return c < 0x80; })) {
+    pool.append(name.begin(), name.end());
+  } else {
+    pool += Utf16ToUtf8(name);
+  }
+  names.size.push_back((u32)(pool.size() - names.offset.back()));
+}
+
+std::string_view RomfsIndex::Name(const Names &names, u32 index) const {
+  return std::string_view(pool).substr(names.offset[index], names.size[index]);
+}
+
+std::size_t RomfsIndex::DirectoryCount() const {
+  return directories.metadata_offset.size();
+}
+
+std::string_view RomfsIndex::DirectoryName(u32 directory) const {
+  if (directory >= DirectoryCount())
+    return {};
+  return Name(directories.names, directory);
+}
+
+u32 RomfsIndex::DirectoryParent(u32 directory) const {
+  return LinkOf(directories.parent, directory);
+}
+
+u32 RomfsIndex::NextDirectory(u32 directory) const {
+  return LinkOf(directories.sibling, directory);
+}
+
+u32 RomfsIndex::FirstChildDirectory(u32 directory) const {
+  return LinkOf(directories.child_directory, directory);
+}
+
+u32 RomfsIndex::FirstChildFile(u32 directory) const {
+  return LinkOf(directories.child_file, directory);
+}
+
+std::size_t RomfsIndex::FileCount() const {
+  return files.metadata_offset.size();
+}
+
+std::string_view RomfsIndex::FileName(u32 file) const {
+  if (file >= FileCount())
+    return {};
+  return Name(files.names, file);
+}
+
+u32 RomfsIndex::FileParent(u32 file) const {
+  return LinkOf(files.parent, file);
+}
+
+u32 RomfsIndex::NextFile(u32 file) const { return LinkOf(files.sibling, file); }
+
+u64 RomfsIndex::FileDataOffset(u32 file) const {
+  return file < FileCount() ? files.data_offset[file] : 0;
+}
+
+u64 RomfsIndex::FileDataSize(u32 file) const {
+  return file < FileCount() ? files.data_size[file] : 0;
+}
+
+u32 RomfsIndex::DirectoryAt(u32 offset) const {
+  return EntryAt(directories.metadata_offset, offset);
+}
+
+u32 RomfsIndex::FileAt(u32 offset) const {
+  return EntryAt(files.metadata_offset, offset);
+}
+
+std::size_t RomfsIndex::MemoryUsage() const {
+  return sizeof(*this) + VectorMemory(directories.metadata_offset) +
+         VectorMemory(directories.names.offset) +
+         VectorMemory(directories.names.size) +
+         VectorMemory(directories.parent) + VectorMemory(directories.sibling) +
+         VectorMemory(directories.child_directory) +
+         VectorMemory(directories.child_file) +
+         VectorMemory(files.metadata_offset) +
+         VectorMemory(files.names.offset) + VectorMemory(files.names.size) +
+         VectorMemory(files.parent) + VectorMemory(files.sibling) +
+         VectorMemory(files.data_offset) + VectorMemory(files.data_size) +
+         pool.capacity();
+}
+
+} // namespace CB
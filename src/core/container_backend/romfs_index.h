@@ -0,0 +1,79 @@
+#pragma once
+
+#include "core/common_types.h"
+#include "core/file_backend/file.h"
+#include <string_view>
+#include <vector>
+
+namespace CB {
+
+// The directory and file tree of a RomFS Level 3, built from one read of
+// each metadata table. Entries are numbered in metadata order, so the root
+// directory is 0, and kept as parallel arrays with their names in one UTF-8
+// pool. Navigating the index does no I/O.
+class RomfsIndex {
+public:
+  // No parent, child or sibling
+  static constexpr u32 k_none = 0xFFFFFFFF;
+
+  RomfsIndex(const FB::FilePtr &directory_metadata,
+             const FB::FilePtr &file_metadata);
+
+  // The accessors take any entry number. For one that does not exist they
+  // return k_none, an empty name or 0, so truncated or damaged metadata
+  // reads as a smaller tree.
+
+  std::size_t DirectoryCount() const;
+  std::string_view DirectoryName(u32 directory) const;
+  u32 DirectoryParent(u32 directory) const;
+  u32 NextDirectory(u32 directory) const;
+  u32 FirstChildDirectory(u32 directory) const;
+  u32 FirstChildFile(u32 directory) const;
+
+  std::size_t FileCount() const;
+  std::string_view FileName(u32 file) const;
+  u32 FileParent(u32 file) const;
+  u32 NextFile(u32 file) const;
+  u64 FileDataOffset(u32 file) const;
+  u64 FileDataSize(u32 file) const;
+
+  // The entry at an offset in its metadata table, or k_none
+  u32 DirectoryAt(u32 offset) const;
+  u32 FileAt(u32 offset) const;
+
+  // Bytes held by the index
+  std::size_t MemoryUsage() const;
+
+private:
+  struct Names {
+    std::vector<u32> offset;
+    std::vector<u32> size;
+  };
+
+  struct Directories {
+    std::vector<u32> metadata_offset;
+    Names names;
+    std::vector<u32> parent;
+    std::vector<u32> sibling;
+    std::vector<u32> child_directory;
+    std::vector<u32> child_file;
+  };
+
+  struct Files {
+    std::vector<u32> metadata_offset;
+    Names names;
+    std::vector<u32> parent;
+    std::vector<u32> sibling;
+    std::vector<u64> data_offset;
+    std::vector<u64> data_size;
+  };
+
+  void AddName(Names &names, const byte *data, u32 size);
+  std::string_view Name(const Names &names, u32 index) const;
+
+  Directories directories;
+  Files files;
+  std::string pool;
+};
+
+} // namespace CB
@@ -1,4 +1,5 @@
 #include "core/container_backend/rsa.h"
+#include "core/container_backend/verification_cache.h"
 #include "core/cryptopp_util.h"
 #include <cryptopp/rsa.h>
 
@@ -11,28 +12,47 @@ Rsa::Rsa(FB::FilePtr data_, FB::FilePtr signature_, FB::FilePtr public_key_)
     InstallList({
         {"Match",
          [this]() {
-           std::size_t data_len = this->data->GetSize();
-           auto d = this->data->Read(0, data_len);
            auto s = this->signature->Read(0, 0x100);
            auto n = this->public_key->Read(0, 0x100);
            if (s.size() != 0x100 || n.size() != 0x100) {
              return std::make_shared<ConstContainer>(false);
            }
+
+           auto &cache = VerificationCache::Global();
+           VerificationCache::Subject subject;
+           byte_seq parameters = s;
+           parameters.insert(parameters.end(), n.begin(), n.end());
+           bool cacheable = cache.MakeSubject("rsa2048-sha256", {this->data},
+                                              parameters, subject);
+           if (cacheable && cache.IsGood(subject))
+             return std::make_shared<ConstContainer>(true);
+
+           std::size_t data_len = this->data->GetSize();
+           byte_seq d;
+           const byte *view = this->data->View(0, data_len);
+           if (!view) {
+             d = this->data->Read(0, data_len);
+             view = d.data();
+             data_len = d.size();
+           }
            bool result = false;
            try {
              result = CryptoPP::RSASS<CryptoPP::PKCS1v15, CryptoPP::SHA256>::
                           Verifier(CryptoPP::Integer(CryptoPPBytes(n), 0x100),
                                    CryptoPP::Integer(0x10001))
-                              .VerifyMessage(CryptoPPBytes(d), data_len,
+                              .VerifyMessage(CryptoPPBytes(view), data_len,
                                              CryptoPPBytes(s), 0x100);
            } catch (...) {
            }
+           // the cache is saved by the next Flush
+           if (cacheable && result)
+             cache.SetGood(subject);
            return std::make_shared<ConstContainer>(result);
          }},
     });
   }
 }
 
-std::any Rsa::Value() { return signature->Read(0, 0x100); }
+Variant Rsa::Value() { return signature->Read(0, 0x100); }
 
 } // namespace CB
\ No newline at end of file
@@ -7,7 +7,7 @@ namespace CB {
 class Rsa : public ContainerHelper {
 public:
   Rsa(FB::FilePtr data, FB::FilePtr signature, FB::FilePtr public_key);
-  std::any Value() override;
+  Variant Value() override;
 
 private:
   FB::FilePtr data;
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "core/container_backend/container.h"
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+namespace CB {
+
+// How a field declared as T is decoded. be_<T> fields decode to T.
+template <typename T> struct FieldTraits {
+  using Type = T;
+  static T Decode(const byte *data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+  }
+};
+
+template <typename T> struct FieldTraits<be_<T>> {
+  using Type = T;
+  static T Decode(const byte *data) {
+    return swap(FieldTraits<T>::Decode(data));
+  }
+};
+
+template <typename T> struct SchemaField {
+  const char *name;
+  std::size_t offset;
+};
+
+template <typename T>
+constexpr SchemaField<T> Member(const char *name, std::size_t offset) {
+  return {name, offset};
+}
+
+// The fixed fields of a header (or of one record of a table), declared as a
+// constexpr. A schema decodes all its fields from one buffer into a Record
+// tuple, and FileContainer::SchemaHandlers serves them by name through Open.
+//
+//   static constexpr Schema header_schema{
+//       Member<u32>("Size", 0x0),
+//       Member<be_<u16>>("Version", 0x4),
+//   };
+template <typename... T> class Schema {
+public:
+  using Record = std::tuple<typename FieldTraits<T>::Type...>;
+  static constexpr std::size_t count = sizeof...(T);
+
+  constexpr Schema(SchemaField<T>... fields) : fields(fields...) {}
+
+  // Bytes from offset 0 that hold all fields
+  constexpr std::size_t Extent() const {
+    return ExtentOf(std::index_sequence_for<T...>{});
+  }
+
+  // Index of the field called name, or count if there is none
+  constexpr std::size_t Find(std::string_view name) const {
+    return FindIn(name, std::index_sequence_for<T...>{});
+  }
+
+  template <std::size_t I> constexpr const char *Name() const {
+    return std::get<I>(fields).name;
+  }
+
+  // data must hold Extent() bytes
+  Record Decode(const byte *data) const {
+    return DecodeAll(data, std::index_sequence_for<T...>{});
+  }
+
+private:
+  template <std::size_t... I>
+  constexpr std::size_t ExtentOf(std::index_sequence<I...>) const {
+    std::size_t ends[] = {0, (std::get<I>(fields).offset +
+                              sizeof(typename FieldTraits<T>::Type))...};
+    std::size_t extent = 0;
+    for (std::size_t end : ends)
+      extent = end > extent ? end : extent;
+    return extent;
+  }
+
+  template <std::size_t... I>
+  constexpr std::size_t FindIn(std::string_view name,
+                               std::index_sequence<I...>) const {
+    const char *names[] = {"", std::get<I>(fields).name...};
+    for (std::size_t i = 0; i < count; ++i) {
+      if (name == names[i + 1])
+        return i;
+    }
+    return count;
+  }
+
+  template <std::size_t... I>
+  Record DecodeAll(const byte *data, std::index_sequence<I...>) const {
+    return Record(FieldTraits<T>::Decode(data + std::get<I>(fields).offset)...);
+  }
+
+  std::tuple<SchemaField<T>...> fields;
+};
+
+} // namespace CB
@@ -22,11 +22,11 @@ public:
     }
   }
 
-  std::any Value() override {
-    auto base_file_any = base->Value();
-    if (base_file_any.type() != typeid(FB::FilePtr))
+  Variant Value() override {
+    auto base_value = base->Value();
+    if (!base_value.Holds<FB::FilePtr>())
       return {};
-    auto base_file = std::any_cast<FB::FilePtr>(base_file_any);
+    auto base_file = base_value.Get<FB::FilePtr>();
 
     std::u16string path_to_hash;
     // TODO proper UTF-8 to UTF-16
@@ -1,6 +1,7 @@
 #include "core/container_backend/sha.h"
-#include "core/cryptopp_util.h"
-#include <cryptopp/sha.h>
+#include "core/container_backend/verification_cache.h"
+#include "core/crypto/sha256.h"
+#include "core/file_backend/hash_pipeline.h"
 
 namespace CB {
 
@@ -9,17 +10,71 @@ Sha::Sha(FB::FilePtr data, FB::FilePtr hash)
   InstallList({
       {"Match",
        [this]() {
-         byte_seq hash(CryptoPP::SHA256::DIGESTSIZE);
+         auto hash2 = this->hash->Read(0, Crypto::SHA256_DIGEST_SIZE);
+
+         // small data is hashed again faster than its result is stored
+         auto &cache = VerificationCache::Global();
+         VerificationCache::Subject subject;
          std::size_t size = this->data->GetSize();
-         auto buffer = this->data->Read(0, size);
-         CryptoPP::SHA256().CalculateDigest(CryptoPPBytes(hash),
-                                            CryptoPPBytes(buffer), size);
-         auto hash2 = this->hash->Read(0, CryptoPP::SHA256::DIGESTSIZE);
-         return std::make_shared<ConstContainer>(hash == hash2);
+         bool cacheable =
+             size >= chunk_size &&
+             cache.MakeSubject("sha256", {this->data}, hash2, subject);
+         if (cacheable && cache.IsGood(subject)) {
+           if (progress)
+             progress(size, size);
+           return std::make_shared<ConstContainer>(true);
+         }
+
+         bool match = Calculate() == hash2;
+         if (cacheable && match) {
+           cache.SetGood(subject);
+           cache.Flush();
+         }
+         return std::make_shared<ConstContainer>(match);
        }},
   });
 }
 
-std::any Sha::Value() { return hash->Read(0, CryptoPP::SHA256::DIGESTSIZE); }
+Variant Sha::Value() { return hash->Read(0, Crypto::SHA256_DIGEST_SIZE); }
+
+void Sha::SetProgressCallback(ProgressCallback callback) {
+  progress = std::move(callback);
+}
+
+byte_seq Sha::Calculate() {
+  Crypto::Sha256 sha;
+  std::size_t size = data->GetSize();
+  std::size_t done = 0;
+
+  // hash mapped data in place
+  if (const byte *view = data->View(0, size)) {
+    while (done != size) {
+      std::size_t part = std::min(chunk_size, size - done);
+      sha.Update(view + done, part);
+      done += part;
+      if (progress)
+        progress(done, size);
+    }
+  } else if (size > chunk_size) {
+    // read, decrypt and hash on separate threads
+    FB::HashPipeline pipeline(chunk_size);
+    if (progress) {
+      pipeline.SetProgressCallback(
+          [this](std::size_t hashed, std::size_t total) {
+            progress(hashed, total);
+            return true;
+          });
+    }
+    return pipeline.Sha256(data);
+  } else {
+    byte_seq buffer = data->Read(0, size);
+    sha.Update(buffer.data(), buffer.size());
+    if (progress)
+      progress(buffer.size(), size);
+  }
+
+  auto digest = sha.Final();
+  return byte_seq(digest.begin(), digest.end());
+}
 
-} // namespace CB
\ No newline at end of file
+} // namespace CB
@@ -6,12 +6,25 @@ namespace CB {
 
 class Sha : public ContainerHelper {
 public:
+  // Called after each hashed chunk with the bytes hashed so far
+  using ProgressCallback =
+      std::function<void(std::size_t done, std::size_t total)>;
+
+  // Data is hashed in chunks of this size, so memory use does not grow with
+  // the size of the data
+  static constexpr std::size_t chunk_size = 0x400000;
+
   Sha(FB::FilePtr data, FB::FilePtr hash);
-  std::any Value() override;
+  Variant Value() override;
+
+  void SetProgressCallback(ProgressCallback callback);
 
 private:
+  byte_seq Calculate();
+
   FB::FilePtr data;
   FB::FilePtr hash;
+  ProgressCallback progress;
 };
 
-} // namespace CB
\ No newline at end of file
+} // namespace CB
@@ -58,17 +58,24 @@ std::array<u16, size * size> Smdh::GetIcon() {
   return result;
 };
 
-Smdh::Smdh(FB::FilePtr file_) : FileContainer(std::move(file_)) {
-  InstallList({
-      {"IconLarge",
-       [this]() {
-         return std::make_shared<ConstContainer>(GetIcon<48, 0x24C0>());
-       }},
-      {"IconSmall",
-       [this]() {
-         return std::make_shared<ConstContainer>(GetIcon<24, 0x2040>());
-       }},
+const ContainerHelper::HandlerTable &Smdh::Handlers() {
+  static const HandlerTable table({
+      Cached(Bind<Smdh>("IconLarge",
+                        [](Smdh &self) {
+                          return std::make_shared<ConstContainer>(
+                              self.GetIcon<48, 0x24C0>());
+                        })),
+      Cached(Bind<Smdh>("IconSmall",
+                        [](Smdh &self) {
+                          return std::make_shared<ConstContainer>(
+                              self.GetIcon<24, 0x2040>());
+                        })),
   });
+  return table;
+}
+
+Smdh::Smdh(FB::FilePtr file_) : FileContainer(std::move(file_)) {
+  InstallTable(Handlers());
 }
 
 } // namespace CB
\ No newline at end of file
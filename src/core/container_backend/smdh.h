@@ -9,6 +9,8 @@ public:
   Smdh(FB::FilePtr file);
 
 private:
+  static const HandlerTable &Handlers();
+
   template <std::size_t size, std::size_t offset>
   std::array<u16, size * size> GetIcon();
 };
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "core/common_types.h"
+#include "core/file_backend/file.h"
+#include <array>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <variant>
+
+namespace CB {
+
+// A std::array of trivially copyable elements (names, magic numbers, icons)
+// kept as bytes. Small arrays are stored inline, larger ones are shared
+// between copies.
+class FixedArray {
+public:
+  template <typename E, std::size_t N>
+  FixedArray(const std::array<E, N> &array)
+      : element_type(&k_element_tag<E>), element_size(sizeof(E)), count(N) {
+    static_assert(std::is_trivially_copyable<E>::value,
+                  "E must be trivially copyable!");
+    if (sizeof(array) <= inline_data.size()) {
+      std::memcpy(inline_data.data(), array.data(), sizeof(array));
+    } else {
+      auto bytes = reinterpret_cast<const byte *>(array.data());
+      heap_data =
+          std::make_shared<const byte_seq>(bytes, bytes + sizeof(array));
+    }
+  }
+
+  template <typename E, std::size_t N> bool Holds() const {
+    return element_type == &k_element_tag<E> && element_size == sizeof(E) &&
+           count == N;
+  }
+
+  // Throws std::bad_variant_access if the array is not N elements of E
+  template <typename E, std::size_t N> std::array<E, N> Get() const {
+    if (!Holds<E, N>())
+      throw std::bad_variant_access();
+    std::array<E, N> result;
+    std::memcpy(result.data(), Data(), sizeof(result));
+    return result;
+  }
+
+private:
+  const byte *Data() const {
+    return heap_data ? heap_data->data() : inline_data.data();
+  }
+
+  // One per element type, so that arrays of different types of the same size
+  // (such as char and u8) are told apart without RTTI
+  template <typename E> static constexpr char k_element_tag = 0;
+
+  const char *element_type;
+  std::size_t element_size;
+  std::size_t count;
+  std::array<byte, 16> inline_data;
+  std::shared_ptr<const byte_seq> heap_data;
+};
+
+// The value of a container. It holds one of the kinds of values containers
+// have, or nothing. Unlike std::any it stores them without allocating
+// (except for strings, byte sequences and large arrays) and checks the type
+// with the variant index instead of RTTI.
+class Variant {
+public:
+  Variant() = default;
+
+  template <typename T, typename = std::enable_if_t<
+                            !std::is_same<std::decay_t<T>, Variant>::value>>
+  Variant(T value) {
+    if constexpr (IsFixedArray<T>::value) {
+      storage.template emplace<FixedArray>(value);
+    } else if constexpr (std::is_convertible<T, FB::FilePtr>::value) {
+      storage.template emplace<FB::FilePtr>(std::move(value));
+    } else {
+      // a compile error here means T is not a kind of value in Storage
+      storage.template emplace<T>(std::move(value));
+    }
+  }
+
+  bool has_value() const {
+    return !std::holds_alternative<std::monostate>(storage);
+  }
+
+  template <typename T> bool Holds() const {
+    if constexpr (IsFixedArray<T>::value) {
+      auto array = std::get_if<FixedArray>(&storage);
+      return array &&
+             array->template Holds<typename T::value_type,
+                                   std::tuple_size<T>::value>();
+    } else {
+      return std::holds_alternative<T>(storage);
+    }
+  }
+
+  // Throws std::bad_variant_access if the value is not a T
+  template <typename T> T Get() const {
+    if constexpr (IsFixedArray<T>::value) {
+      return std::get<FixedArray>(storage)
+          .template Get<typename T::value_type, std::tuple_size<T>::value>();
+    } else {
+      return std::get<T>(storage);
+    }
+  }
+
+private:
+  template <typename T> struct IsFixedArray : std::false_type {};
+  template <typename E, std::size_t N>
+  struct IsFixedArray<std::array<E, N>> : std::true_type {};
+
+  using Storage = std::variant<std::monostate, bool, u8, u16, u32, u64,
+                               std::string, byte_seq, FB::FilePtr, FixedArray>;
+  Storage storage;
+};
+
+} // namespace CB
@@ -0,0 +1,86 @@
+#include "core/container_backend/verification.h"
+#include "core/container_backend/ivfc_verifier.h"
+#include <algorithm>
+#include <cmath>
+
+namespace CB {
+
+void VerificationResult::AddMatch(const std::string &name,
+                                  const ContainerPtr &check) {
+  ContainerPtr match = check ? check->Open("Match") : nullptr;
+  if (!match) {
+    Add(name, Status::Unavailable);
+    return;
+  }
+  Add(name, match->ValueT<bool>() ? Status::Passed : Status::Failed);
+}
+
+void VerificationResult::Add(const std::string &name, Status status) {
+  checks.push_back({name, status});
+}
+
+void VerificationResult::AddIvfc(const std::string &name,
+                                 const ContainerPtr &romfs,
+                                 const VerificationOptions &options) {
+  if (!romfs) {
+    Add(name, Status::Unavailable);
+    return;
+  }
+  IvfcVerifier verifier(romfs);
+  total_blocks += verifier.GetTotalBlocks();
+  if (options.level == VerificationLevel::Quick)
+    return;
+
+  if (options.level == VerificationLevel::Sampled)
+    verifier.SetSampling(options.sample_fraction, options.seed);
+  verifier.Run();
+  checked_blocks += verifier.GetCheckedBlocks();
+  failed_blocks += verifier.GetCheckedBlocks() - verifier.GetPassedBlocks();
+  Add(name, verifier.GetMismatches().empty() ? Status::Passed
+                                             : Status::Failed);
+}
+
+void VerificationResult::Merge(const std::string &prefix,
+                               const VerificationResult &other) {
+  for (const Check &check : other.checks)
+    checks.push_back({prefix + check.name, check.status});
+  total_blocks += other.total_blocks;
+  checked_blocks += other.checked_blocks;
+  failed_blocks += other.failed_blocks;
+}
+
+bool VerificationResult::Passed() const {
+  return std::none_of(checks.begin(), checks.end(), [](const Check &check) {
+    return check.status == Status::Failed;
+  });
+}
+
+const std::vector<VerificationResult::Check> &
+VerificationResult::GetChecks() const {
+  return checks;
+}
+
+u64 VerificationResult::GetTotalBlocks() const { return total_blocks; }
+
+u64 VerificationResult::GetCheckedBlocks() const { return checked_blocks; }
+
+u64 VerificationResult::GetFailedBlocks() const { return failed_blocks; }
+
+double VerificationResult::Confidence(double damaged_fraction) const {
+  if (checked_blocks >= total_blocks)
+    return 1;
+  u64 damaged = (u64)std::ceil(total_blocks * damaged_fraction);
+  if (damaged == 0)
+    return 0;
+
+  // the chance that each checked block, drawn without replacement, is good
+  double log_miss = 0;
+  for (u64 i = 0; i < checked_blocks; ++i) {
+    if (total_blocks - i <= damaged)
+      return 1;
+    log_miss += std::log1p(-(double)damaged / (double)(total_blocks - i));
+  }
+  return 1 - std::exp(log_miss);
+}
+
+} // namespace CB
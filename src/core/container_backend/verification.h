@@ -0,0 +1,77 @@
+#pragma once
+
+#include "core/container_backend/container.h"
+#include <string>
+#include <vector>
+
+namespace CB {
+
+// How much of a title Verify checks
+enum class VerificationLevel {
+  // Signatures and the hashes of headers: the exheader and the ExeFS and
+  // RomFS superblocks. Reads a few kilobytes.
+  Quick,
+  // Quick, and a random fraction of the RomFS hash tree blocks
+  Sampled,
+  // Every hash: all hash tree blocks, ExeFS sections and CIA contents
+  Full,
+};
+
+struct VerificationOptions {
+  VerificationLevel level = VerificationLevel::Full;
+
+  // For Sampled, the fraction of blocks checked
+  double sample_fraction = 0.01;
+
+  // For Sampled, the blocks checked are picked by this seed. 0 picks
+  // different blocks each time.
+  u64 seed = 0;
+};
+
+class VerificationResult {
+public:
+  enum class Status {
+    Passed,
+    Failed,
+    // missing keys or data
+    Unavailable,
+  };
+
+  struct Check {
+    std::string name;
+    Status status;
+  };
+
+  // Runs the Match of a Sha or Rsa container. check may be null.
+  void AddMatch(const std::string &name, const ContainerPtr &check);
+  void Add(const std::string &name, Status status);
+
+  // Checks the hash tree blocks of a Romfs container as options say
+  void AddIvfc(const std::string &name, const ContainerPtr &romfs,
+               const VerificationOptions &options);
+
+  // Adds the checks of a sub-container, with names prefixed
+  void Merge(const std::string &prefix, const VerificationResult &other);
+
+  // True if no check failed. Unavailable checks don't count as failures.
+  bool Passed() const;
+
+  const std::vector<Check> &GetChecks() const;
+
+  // Hash tree blocks of the title, and how many were checked or failed
+  u64 GetTotalBlocks() const;
+  u64 GetCheckedBlocks() const;
+  u64 GetFailedBlocks() const;
+
+  // The probability that the checked blocks include a bad one if
+  // damaged_fraction of all blocks are bad. 1 if every block was checked.
+  double Confidence(double damaged_fraction = 0.01) const;
+
+private:
+  std::vector<Check> checks;
+  u64 total_blocks = 0;
+  u64 checked_blocks = 0;
+  u64 failed_blocks = 0;
+};
+
+} // namespace CB
@@ -0,0 +1,233 @@
+#include "core/container_backend/verification_cache.h"
+#include "core/crypto/sha256.h"
+#include "core/file_backend/disk_file.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace CB {
+
+static const char k_magic[] = "citrogenverified";
+
+using StdioFile = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+template <typename T> static bool ReadValue(std::FILE *file, T &value) {
+  return std::fread(&value, sizeof(T), 1, file) == 1;
+}
+
+template <typename T> static void WriteValue(std::FILE *file, const T &value) {
+  std::fwrite(&value, sizeof(T), 1, file);
+}
+
+// Strings and byte sequences are stored as a u64 size and the bytes
+template <typename Bytes>
+static bool ReadBytes(std::FILE *file, Bytes &bytes) {
+  u64 size;
+  // names and keys are short, so a damaged file can't make us allocate much
+  if (!ReadValue(file, size) || size > 0x10000)
+    return false;
+  bytes.resize((std::size_t)size);
+  return size == 0 || std::fread(&bytes[0], (std::size_t)size, 1, file) == 1;
+}
+
+template <typename Bytes>
+static void WriteBytes(std::FILE *file, const Bytes &bytes) {
+  WriteValue<u64>(file, bytes.size());
+  std::fwrite(bytes.data(), bytes.size(), 1, file);
+}
+
+VerificationCache &VerificationCache::Global() {
+  static VerificationCache cache;
+  return cache;
+}
+
+void VerificationCache::Open(const std::string &file_name_) {
+  std::lock_guard<std::mutex> lock(mutex);
+  file_name = file_name_;
+  files.clear();
+  if (!Load())
+    files.clear();
+  dirty = false;
+
+  for (auto iter = files.begin(); iter != files.end();) {
+    FB::FileIdentity current;
+    if (FB::GetFileIdentity(iter->first.path, current) &&
+        current == iter->first) {
+      ++iter;
+    } else {
+      iter = files.erase(iter);
+      dirty = true;
+    }
+  }
+}
+
+void VerificationCache::Flush() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!dirty || file_name.empty())
+    return;
+  if (Save())
+    dirty = false;
+}
+
+bool VerificationCache::Load() {
+  StdioFile file(std::fopen(file_name.c_str(), "rb"), &std::fclose);
+  if (!file)
+    return false;
+  char magic[16];
+  if (std::fread(magic, 16, 1, file.get()) != 1 ||
+      std::memcmp(magic, k_magic, 16) != 0)
+    return false;
+
+  u64 file_count;
+  if (!ReadValue(file.get(), file_count))
+    return false;
+  for (u64 i = 0; i < file_count; ++i) {
+    FB::FileIdentity identity;
+    u64 subject_count;
+    if (!ReadBytes(file.get(), identity.path) ||
+        !ReadValue(file.get(), identity.size) ||
+        !ReadValue(file.get(), identity.modified) ||
+        !ReadValue(file.get(), identity.device) ||
+        !ReadValue(file.get(), identity.index) ||
+        !ReadValue(file.get(), subject_count))
+      return false;
+    Results &results = files[identity];
+    for (u64 j = 0; j < subject_count; ++j) {
+      byte_seq key;
+      u64 range_count;
+      if (!ReadBytes(file.get(), key) || !ReadValue(file.get(), range_count))
+        return false;
+      std::vector<BlockRange> &ranges = results[key];
+      for (u64 k = 0; k < range_count; ++k) {
+        BlockRange range;
+        if (!ReadValue(file.get(), range.first) ||
+            !ReadValue(file.get(), range.count))
+          return false;
+        ranges.push_back(range);
+      }
+    }
+  }
+  return true;
+}
+
+bool VerificationCache::Save() const {
+  // write a new file and replace the old one, so an interrupted save leaves
+  // the old results
+  std::string temp_name = file_name + ".new";
+  {
+    StdioFile file(std::fopen(temp_name.c_str(), "wb"), &std::fclose);
+    if (!file)
+      return false;
+    std::fwrite(k_magic, 16, 1, file.get());
+    WriteValue<u64>(file.get(), files.size());
+    for (const auto & [ identity, results ] : files) {
+      WriteBytes(file.get(), identity.path);
+      WriteValue(file.get(), identity.size);
+      WriteValue(file.get(), identity.modified);
+      WriteValue(file.get(), identity.device);
+      WriteValue(file.get(), identity.index);
+      WriteValue<u64>(file.get(), results.size());
+      for (const auto & [ key, ranges ] : results) {
+        WriteBytes(file.get(), key);
+        WriteValue<u64>(file.get(), ranges.size());
+        for (const BlockRange &range : ranges) {
+          WriteValue(file.get(), range.first);
+          WriteValue(file.get(), range.count);
+        }
+      }
+    }
+    if (std::ferror(file.get()) || std::fclose(file.release()) != 0) {
+      std::remove(temp_name.c_str());
+      return false;
+    }
+  }
+#ifdef _WIN32
+  // rename doesn't replace existing files here
+  std::remove(file_name.c_str());
+#endif
+  return std::rename(temp_name.c_str(), file_name.c_str()) == 0;
+}
+
+bool VerificationCache::MakeSubject(const std::string &kind,
+                                    const std::vector<FB::FilePtr> &files,
+                                    const byte_seq &parameters,
+                                    Subject &subject) {
+  Crypto::Sha256 sha;
+  sha.Update(reinterpret_cast<const byte *>(kind.data()), kind.size() + 1);
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    FB::FileOrigin origin;
+    if (!files[i]->GetOrigin(origin))
+      return false;
+    if (i == 0)
+      subject.identity = origin.identity;
+    else if (!(origin.identity == subject.identity))
+      return false;
+    if (i == 0) {
+      // the file may have been changed in place while it is open, and its
+      // reads already return the new data
+      FB::FileIdentity current;
+      if (!FB::GetFileIdentity(subject.identity.path, current) ||
+          !(current == subject.identity)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (this->files.erase(subject.identity))
+          dirty = true;
+        return false;
+      }
+    }
+    u64 size = files[i]->GetSize();
+    u64 transform_size = origin.transform.size();
+    sha.Update(reinterpret_cast<const byte *>(&transform_size), sizeof(u64));
+    sha.Update(origin.transform.data(), origin.transform.size());
+    sha.Update(reinterpret_cast<const byte *>(&origin.offset), sizeof(u64));
+    sha.Update(reinterpret_cast<const byte *>(&size), sizeof(u64));
+  }
+  sha.Update(parameters.data(), parameters.size());
+  auto digest = sha.Final();
+  subject.key.assign(digest.begin(), digest.end());
+  return true;
+}
+
+bool VerificationCache::IsGood(const Subject &subject) {
+  std::vector<BlockRange> ranges = GoodBlocks(subject);
+  return !ranges.empty() && ranges[0].first == 0;
+}
+
+void VerificationCache::SetGood(const Subject &subject) {
+  AddGoodBlocks(subject, {0, 1});
+}
+
+std::vector<VerificationCache::BlockRange>
+VerificationCache::GoodBlocks(const Subject &subject) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto file = files.find(subject.identity);
+  if (file == files.end())
+    return {};
+  auto found = file->second.find(subject.key);
+  if (found == file->second.end())
+    return {};
+  return found->second;
+}
+
+void VerificationCache::AddGoodBlocks(const Subject &subject,
+                                      BlockRange range) {
+  if (range.count == 0)
+    return;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<BlockRange> &ranges = files[subject.identity][subject.key];
+
+  // merge with the ranges it overlaps or touches
+  auto begin = std::lower_bound(
+      ranges.begin(), ranges.end(), range.first,
+      [](const BlockRange &r, u64 first) { return r.first + r.count < first; });
+  auto end = begin;
+  u64 first = range.first, last = range.first + range.count;
+  for (; end != ranges.end() && end->first <= last; ++end) {
+    first = std::min(first, end->first);
+    last = std::max(last, end->first + end->count);
+  }
+  begin = ranges.erase(begin, end);
+  ranges.insert(begin, {first, last - first});
+  dirty = true;
+}
+
+} // namespace CB
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "core/common_types.h"
+#include "core/file_backend/file.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace CB {
+
+// Remembers verification passes across runs, so unchanged files are not
+// checked again. Results are grouped by the disk file the checked data comes
+// from and dropped when that file changes (see FB::FileIdentity). Failures
+// are not remembered.
+class VerificationCache {
+public:
+  // Blocks first to first + count - 1
+  struct BlockRange {
+    u64 first;
+    u64 count;
+  };
+
+  // A check of some data against some expected values
+  struct Subject {
+    FB::FileIdentity identity;
+    byte_seq key;
+  };
+
+  static VerificationCache &Global();
+
+  // Loads the results saved in file_name, dropping those of changed files.
+  // Flush saves to the same file.
+  void Open(const std::string &file_name);
+
+  // Saves the results if they changed since the last save
+  void Flush();
+
+  // Makes the subject of a check of the given kind on files, whose outcome
+  // is determined by parameters. Returns false if the data of a file is not
+  // from a disk file, or not all from the same one, or if the disk file
+  // changed since it was opened. Results for a changed file are dropped.
+  bool MakeSubject(const std::string &kind,
+                   const std::vector<FB::FilePtr> &files,
+                   const byte_seq &parameters, Subject &subject);
+
+  bool IsGood(const Subject &subject);
+  void SetGood(const Subject &subject);
+
+  // For checks made of independent blocks. The ranges are sorted and don't
+  // touch each other.
+  std::vector<BlockRange> GoodBlocks(const Subject &subject);
+  void AddGoodBlocks(const Subject &subject, BlockRange range);
+
+private:
+  using Results = std::map<byte_seq, std::vector<BlockRange>>;
+
+  bool Load();
+  bool Save() const;
+
+  std::mutex mutex;
+  std::string file_name;
+  std::map<FB::FileIdentity, Results> files;
+  bool dirty = false;
+};
+
+} // namespace CB
@@ -0,0 +1,295 @@
+#include "core/crypto/aes.h"
+#include "core/crypto/aes_kernels.h"
+#include "core/crypto/cpu_features.h"
+#include <algorithm>
+
+namespace Crypto {
+
+// multiplication in GF(2^8) with the AES polynomial
+static u8 Mul(u8 a, u8 b) {
+  u8 result = 0;
+  while (b) {
+    if (b & 1)
+      result ^= a;
+    a = (u8)((a << 1) ^ ((a & 0x80) ? 0x1B : 0));
+    b >>= 1;
+  }
+  return result;
+}
+
+static u32 Ror(u32 value, unsigned shift) {
+  return (value >> shift) | (value << (32 - shift));
+}
+
+struct AesTables {
+  u8 sbox[256];
+  u8 inv_sbox[256];
+  u32 te[4][256];
+  u32 td[4][256];
+
+  AesTables() {
+    for (unsigned x = 0; x < 256; ++x) {
+      u8 inverse = 0;
+      for (unsigned y = 1; x != 0 && y < 256; ++y) {
+        if (Mul((u8)x, (u8)y) == 1) {
+          inverse = (u8)y;
+          break;
+        }
+      }
+      u8 s = inverse;
+      for (unsigned i = 1; i < 5; ++i)
+        s ^= (u8)((inverse << i) | (inverse >> (8 - i)));
+      s ^= 0x63;
+      sbox[x] = s;
+      inv_sbox[s] = (u8)x;
+    }
+
+    for (unsigned x = 0; x < 256; ++x) {
+      u8 s = sbox[x], si = inv_sbox[x];
+      u32 e = ((u32)Mul(s, 2) << 24) | ((u32)s << 16) | ((u32)s << 8) |
+              Mul(s, 3);
+      u32 d = ((u32)Mul(si, 0x0E) << 24) | ((u32)Mul(si, 0x09) << 16) |
+              ((u32)Mul(si, 0x0D) << 8) | Mul(si, 0x0B);
+      for (unsigned i = 0; i < 4; ++i) {
+        te[i][x] = i ? Ror(e, 8 * i) : e;
+        td[i][x] = i ? Ror(d, 8 * i) : d;
+      }
+    }
+  }
+};
+
+static const AesTables &GetTables() {
+  static const AesTables tables;
+  return tables;
+}
+
+static u32 LoadWord(const byte *p) {
+  return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | (u32)p[3];
+}
+
+static void StoreWord(byte *p, u32 value) {
+  p[0] = byte(value >> 24);
+  p[1] = byte(value >> 16);
+  p[2] = byte(value >> 8);
+  p[3] = byte(value);
+}
+
+static u64 LoadU64(const byte *p) {
+  return ((u64)LoadWord(p) << 32) | LoadWord(p + 4);
+}
+
+static void StoreU64(byte *p, u64 value) {
+  StoreWord(p, (u32)(value >> 32));
+  StoreWord(p + 4, (u32)value);
+}
+
+static void EncryptBlock(const AesTables &t, const u32 *rk, const byte *in,
+                         byte *out) {
+  u32 s0 = LoadWord(in) ^ rk[0], s1 = LoadWord(in + 4) ^ rk[1],
+      s2 = LoadWord(in + 8) ^ rk[2], s3 = LoadWord(in + 12) ^ rk[3];
+  for (unsigned round = 1; round < 10; ++round) {
+    rk += 4;
+    u32 t0 = t.te[0][s0 >> 24] ^ t.te[1][(s1 >> 16) & 0xFF] ^
+             t.te[2][(s2 >> 8) & 0xFF] ^ t.te[3][s3 & 0xFF] ^ rk[0];
+    u32 t1 = t.te[0][s1 >> 24] ^ t.te[1][(s2 >> 16) & 0xFF] ^
+             t.te[2][(s3 >> 8) & 0xFF] ^ t.te[3][s0 & 0xFF] ^ rk[1];
+    u32 t2 = t.te[0][s2 >> 24] ^ t.te[1][(s3 >> 16) & 0xFF] ^
+             t.te[2][(s0 >> 8) & 0xFF] ^ t.te[3][s1 & 0xFF] ^ rk[2];
+    u32 t3 = t.te[0][s3 >> 24] ^ t.te[1][(s0 >> 16) & 0xFF] ^
+             t.te[2][(s1 >> 8) & 0xFF] ^ t.te[3][s2 & 0xFF] ^ rk[3];
+    s0 = t0, s1 = t1, s2 = t2, s3 = t3;
+  }
+  rk += 4;
+  const u8 *s = t.sbox;
+  auto last = [s](u32 a, u32 b, u32 c, u32 d) {
+    return ((u32)s[a >> 24] << 24) | ((u32)s[(b >> 16) & 0xFF] << 16) |
+           ((u32)s[(c >> 8) & 0xFF] << 8) | (u32)s[d & 0xFF];
+  };
+  StoreWord(out, last(s0, s1, s2, s3) ^ rk[0]);
+  StoreWord(out + 4, last(s1, s2, s3, s0) ^ rk[1]);
+  StoreWord(out + 8, last(s2, s3, s0, s1) ^ rk[2]);
+  StoreWord(out + 12, last(s3, s0, s1, s2) ^ rk[3]);
+}
+
+static void DecryptBlock(const AesTables &t, const u32 *rk, const byte *in,
+                         byte *out) {
+  u32 s0 = LoadWord(in) ^ rk[0], s1 = LoadWord(in + 4) ^ rk[1],
+      s2 = LoadWord(in + 8) ^ rk[2], s3 = LoadWord(in + 12) ^ rk[3];
+  for (unsigned round = 1; round < 10; ++round) {
+    rk += 4;
+    u32 t0 = t.td[0][s0 >> 24] ^ t.td[1][(s3 >> 16) & 0xFF] ^
+             t.td[2][(s2 >> 8) & 0xFF] ^ t.td[3][s1 & 0xFF] ^ rk[0];
+    u32 t1 = t.td[0][s1 >> 24] ^ t.td[1][(s0 >> 16) & 0xFF] ^
+             t.td[2][(s3 >> 8) & 0xFF] ^ t.td[3][s2 & 0xFF] ^ rk[1];
+    u32 t2 = t.td[0][s2 >> 24] ^ t.td[1][(s1 >> 16) & 0xFF] ^
+             t.td[2][(s0 >> 8) & 0xFF] ^ t.td[3][s3 & 0xFF] ^ rk[2];
+    u32 t3 = t.td[0][s3 >> 24] ^ t.td[1][(s2 >> 16) & 0xFF] ^
+             t.td[2][(s1 >> 8) & 0xFF] ^ t.td[3][s0 & 0xFF] ^ rk[3];
+    s0 = t0, s1 = t1, s2 = t2, s3 = t3;
+  }
+  rk += 4;
+  const u8 *s = t.inv_sbox;
+  auto last = [s](u32 a, u32 b, u32 c, u32 d) {
+    return ((u32)s[a >> 24] << 24) | ((u32)s[(b >> 16) & 0xFF] << 16) |
+           ((u32)s[(c >> 8) & 0xFF] << 8) | (u32)s[d & 0xFF];
+  };
+  StoreWord(out, last(s0, s3, s2, s1) ^ rk[0]);
+  StoreWord(out + 4, last(s1, s0, s3, s2) ^ rk[1]);
+  StoreWord(out + 8, last(s2, s1, s0, s3) ^ rk[2]);
+  StoreWord(out + 12, last(s3, s2, s1, s0) ^ rk[3]);
+}
+
+static void LoadRoundKeys(const byte *bytes, u32 words[44]) {
+  for (unsigned i = 0; i < 44; ++i)
+    words[i] = LoadWord(bytes + i * 4);
+}
+
+struct AesKernelSet {
+  AesCtrKernel ctr;
+  AesCbcDecryptKernel cbc_decrypt;
+  const char *name;
+};
+
+static AesKernelSet SelectKernels() {
+#ifdef AES_X86_KERNELS
+  const CpuFeatures &features = GetCpuFeatures();
+  if (features.aes_ni && features.vaes)
+    return {AesCtrVaes, AesCbcDecryptVaes, "VAES/AVX-512"};
+  if (features.aes_ni && features.sse41)
+    return {AesCtrAesNi, AesCbcDecryptAesNi, "AES-NI"};
+#endif
+  return {AesCtrPortable, AesCbcDecryptPortable, "portable"};
+}
+
+static const AesKernelSet &GetKernels() {
+  static const AesKernelSet kernels = SelectKernels();
+  return kernels;
+}
+
+void AesCtrPortable(const Aes128::RoundKeys &keys, u64 counter_high,
+                    u64 counter_low, const byte *in, byte *out,
+                    std::size_t blocks) {
+  const AesTables &t = GetTables();
+  u32 rk[44];
+  LoadRoundKeys(keys.enc, rk);
+  byte counter[16], stream[16];
+  for (std::size_t i = 0; i < blocks; ++i) {
+    StoreU64(counter, counter_high);
+    StoreU64(counter + 8, counter_low);
+    EncryptBlock(t, rk, counter, stream);
+    for (unsigned j = 0; j < 16; ++j)
+      out[i * 16 + j] = in[i * 16 + j] ^ stream[j];
+    if (++counter_low == 0)
+      ++counter_high;
+  }
+}
+
+void AesCbcDecryptPortable(const Aes128::RoundKeys &keys, const byte *iv,
+                           const byte *in, byte *out, std::size_t blocks) {
+  const AesTables &t = GetTables();
+  u32 rk[44];
+  LoadRoundKeys(keys.dec, rk);
+  byte prev[16], cipher[16], plain[16];
+  std::memcpy(prev, iv, 16);
+  for (std::size_t i = 0; i < blocks; ++i) {
+    std::memcpy(cipher, in + i * 16, 16);
+    DecryptBlock(t, rk, cipher, plain);
+    for (unsigned j = 0; j < 16; ++j)
+      out[i * 16 + j] = plain[j] ^ prev[j];
+    std::memcpy(prev, cipher, 16);
+  }
+}
+
+Aes128::Aes128(const AESKey &key) {
+  const AesTables &t = GetTables();
+  static const u8 rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10,
+                              0x20, 0x40, 0x80, 0x1B, 0x36};
+
+  u32 w[44];
+  for (unsigned i = 0; i < 4; ++i)
+    w[i] = LoadWord(key.data() + i * 4);
+  for (unsigned i = 4; i < 44; ++i) {
+    u32 temp = w[i - 1];
+    if (i % 4 == 0) {
+      temp = (temp << 8) | (temp >> 24);
+      temp = ((u32)t.sbox[temp >> 24] << 24) |
+             ((u32)t.sbox[(temp >> 16) & 0xFF] << 16) |
+             ((u32)t.sbox[(temp >> 8) & 0xFF] << 8) | t.sbox[temp & 0xFF];
+      temp ^= (u32)rcon[i / 4 - 1] << 24;
+    }
+    w[i] = w[i - 4] ^ temp;
+  }
+
+  // the equivalent inverse cipher uses the round keys in reverse order, with
+  // InvMixColumns applied to all but the first and the last
+  u32 dw[44];
+  for (unsigned round = 0; round < 11; ++round) {
+    for (unsigned j = 0; j < 4; ++j) {
+      u32 value = w[(10 - round) * 4 + j];
+      if (round != 0 && round != 10) {
+        value = t.td[0][t.sbox[value >> 24]] ^
+                t.td[1][t.sbox[(value >> 16) & 0xFF]] ^
+                t.td[2][t.sbox[(value >> 8) & 0xFF]] ^
+                t.td[3][t.sbox[value & 0xFF]];
+      }
+      dw[round * 4 + j] = value;
+    }
+  }
+
+  for (unsigned i = 0; i < 44; ++i) {
+    StoreWord(keys.enc + i * 4, w[i]);
+    StoreWord(keys.dec + i * 4, dw[i]);
+  }
+}
+
+void Aes128::CtrXor(const AESKey &iv, u64 pos, const byte *in, byte *out,
+                    std::size_t size) const {
+  const AesKernelSet &kernels = GetKernels();
+  u64 high = LoadU64(iv.data());
+  u64 low = LoadU64(iv.data() + 8);
+  auto advance = [&high, &low](u64 blocks) {
+    low += blocks;
+    if (low < blocks)
+      ++high;
+  };
+  advance(pos / 16);
+
+  // partial blocks at either end go through a keystream block on stack
+  auto partial = [&](std::size_t offset, std::size_t length) {
+    byte stream[16] = {};
+    kernels.ctr(keys, high, low, stream, stream, 1);
+    for (std::size_t i = 0; i < length; ++i)
+      out[i] = in[i] ^ stream[offset + i];
+    in += length;
+    out += length;
+    size -= length;
+  };
+
+  std::size_t offset = (std::size_t)(pos % 16);
+  if (offset != 0 && size != 0) {
+    partial(offset, std::min<std::size_t>(size, 16 - offset));
+    advance(1);
+  }
+
+  std::size_t blocks = size / 16;
+  if (blocks != 0) {
+    kernels.ctr(keys, high, low, in, out, blocks);
+    advance(blocks);
+    in += blocks * 16;
+    out += blocks * 16;
+    size -= blocks * 16;
+  }
+
+  if (size != 0) {
+    partial(0, size);
+  }
+}
+
+void Aes128::CbcDecrypt(const AESKey &iv, const byte *in, byte *out,
+                        std::size_t size) const {
+  GetKernels().cbc_decrypt(keys, iv.data(), in, out, size / 16);
+}
+
+const char *Aes128::KernelName() { return GetKernels().name; }
+
+} // namespace Crypto
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "core/aes_key.h"
+
+namespace Crypto {
+
+// AES-128 with an expanded key schedule. The bulk operations run on the
+// fastest kernel the CPU supports (VAES/AVX-512, AES-NI or portable C++),
+// chosen once at runtime. The object is only read after construction, so
+// one instance can be used by any number of threads at the same time.
+class Aes128 {
+public:
+  explicit Aes128(const AESKey &key);
+
+  // XORs the CTR keystream into size bytes of data, starting at byte offset
+  // pos of the stream. The counter is the 128-bit big-endian iv incremented
+  // once per block. in and out may be the same buffer.
+  void CtrXor(const AESKey &iv, u64 pos, const byte *in, byte *out,
+              std::size_t size) const;
+
+  // Decrypts size bytes (a multiple of the block size) of CBC ciphertext.
+  // in and out may be the same buffer.
+  void CbcDecrypt(const AESKey &iv, const byte *in, byte *out,
+                  std::size_t size) const;
+
+  // Round keys for the encryption and the equivalent inverse cipher
+  struct RoundKeys {
+    alignas(16) byte enc[176];
+    alignas(16) byte dec[176];
+  };
+
+  // Name of the kernel in use, for diagnostics
+  static const char *KernelName();
+
+private:
+  RoundKeys keys;
+};
+
+} // namespace Crypto
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "core/crypto/aes.h"
+
+// Internal interface between Aes128 and its instruction set specific kernels.
+// All kernels process whole blocks and accept in == out.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define AES_X86_KERNELS
+#endif
+
+namespace Crypto {
+
+// the 128-bit counter is passed as two host-order halves of the big-endian
+// value
+using AesCtrKernel = void (*)(const Aes128::RoundKeys &keys, u64 counter_high,
+                              u64 counter_low, const byte *in, byte *out,
+                              std::size_t blocks);
+using AesCbcDecryptKernel = void (*)(const Aes128::RoundKeys &keys,
+                                     const byte *iv, const byte *in,
+                                     byte *out, std::size_t blocks);
+
+void AesCtrPortable(const Aes128::RoundKeys &keys, u64 counter_high,
+                    u64 counter_low, const byte *in, byte *out,
+                    std::size_t blocks);
+void AesCbcDecryptPortable(const Aes128::RoundKeys &keys, const byte *iv,
+                           const byte *in, byte *out, std::size_t blocks);
+
+#ifdef AES_X86_KERNELS
+void AesCtrAesNi(const Aes128::RoundKeys &keys, u64 counter_high,
+                 u64 counter_low, const byte *in, byte *out,
+                 std::size_t blocks);
+void AesCbcDecryptAesNi(const Aes128::RoundKeys &keys, const byte *iv,
+                        const byte *in, byte *out, std::size_t blocks);
+void AesCtrVaes(const Aes128::RoundKeys &keys, u64 counter_high,
+                u64 counter_low, const byte *in, byte *out, std::size_t blocks);
+void AesCbcDecryptVaes(const Aes128::RoundKeys &keys, const byte *iv,
+                       const byte *in, byte *out, std::size_t blocks);
+#endif
+
+} // namespace Crypto
@@ -0,0 +1,107 @@
+// AES-NI kernels. This file is compiled with AES-NI and SSE4.1 enabled and
+// must only be entered after checking the CPU features.
+
+#include "core/crypto/aes_kernels.h"
+
+#ifdef AES_X86_KERNELS
+#include <immintrin.h>
+
+namespace Crypto {
+
+// number of blocks in flight, enough to hide the latency of aesenc
+constexpr std::size_t k_aes_ni_lanes = 8;
+
+static inline __m128i MakeCounter(u64 high, u64 low) {
+  return _mm_set_epi64x((long long)swap64(low), (long long)swap64(high));
+}
+
+void AesCtrAesNi(const Aes128::RoundKeys &keys, u64 counter_high,
+                 u64 counter_low, const byte *in, byte *out,
+                 std::size_t blocks) {
+  __m128i k[11];
+  for (unsigned r = 0; r < 11; ++r)
+    k[r] = _mm_load_si128(reinterpret_cast<const __m128i *>(keys.enc) + r);
+
+  auto next_counter = [&counter_high, &counter_low]() {
+    __m128i counter = MakeCounter(counter_high, counter_low);
+    if (++counter_low == 0)
+      ++counter_high;
+    return counter;
+  };
+
+  while (blocks >= k_aes_ni_lanes) {
+    __m128i b[k_aes_ni_lanes];
+    for (std::size_t i = 0; i < k_aes_ni_lanes; ++i)
+      b[i] = _mm_xor_si128(next_counter(), k[0]);
+    for (unsigned r = 1; r < 10; ++r)
+      for (std::size_t i = 0; i < k_aes_ni_lanes; ++i)
+        b[i] = _mm_aesenc_si128(b[i], k[r]);
+    for (std::size_t i = 0; i < k_aes_ni_lanes; ++i) {
+      b[i] = _mm_aesenclast_si128(b[i], k[10]);
+      __m128i data =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(in) + i);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out) + i,
+                       _mm_xor_si128(data, b[i]));
+    }
+    in += k_aes_ni_lanes * 16;
+    out += k_aes_ni_lanes * 16;
+    blocks -= k_aes_ni_lanes;
+  }
+
+  for (; blocks != 0; --blocks) {
+    __m128i b = _mm_xor_si128(next_counter(), k[0]);
+    for (unsigned r = 1; r < 10; ++r)
+      b = _mm_aesenc_si128(b, k[r]);
+    b = _mm_aesenclast_si128(b, k[10]);
+    __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_xor_si128(data, b));
+    in += 16;
+    out += 16;
+  }
+}
+
+void AesCbcDecryptAesNi(const Aes128::RoundKeys &keys, const byte *iv,
+                        const byte *in, byte *out, std::size_t blocks) {
+  __m128i k[11];
+  for (unsigned r = 0; r < 11; ++r)
+    k[r] = _mm_load_si128(reinterpret_cast<const __m128i *>(keys.dec) + r);
+
+  // all ciphertext of a batch is loaded before anything is stored, so that
+  // decrypting in place works
+  __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i *>(iv));
+  while (blocks >= k_aes_ni_lanes) {
+    __m128i c[k_aes_ni_lanes], b[k_aes_ni_lanes];
+    for (std::size_t i = 0; i < k_aes_ni_lanes; ++i) {
+      c[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in) + i);
+      b[i] = _mm_xor_si128(c[i], k[0]);
+    }
+    for (unsigned r = 1; r < 10; ++r)
+      for (std::size_t i = 0; i < k_aes_ni_lanes; ++i)
+        b[i] = _mm_aesdec_si128(b[i], k[r]);
+    for (std::size_t i = 0; i < k_aes_ni_lanes; ++i) {
+      b[i] = _mm_aesdeclast_si128(b[i], k[10]);
+      b[i] = _mm_xor_si128(b[i], i == 0 ? prev : c[i - 1]);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out) + i, b[i]);
+    }
+    prev = c[k_aes_ni_lanes - 1];
+    in += k_aes_ni_lanes * 16;
+    out += k_aes_ni_lanes * 16;
+    blocks -= k_aes_ni_lanes;
+  }
+
+  for (; blocks != 0; --blocks) {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+    __m128i b = _mm_xor_si128(c, k[0]);
+    for (unsigned r = 1; r < 10; ++r)
+      b = _mm_aesdec_si128(b, k[r]);
+    b = _mm_aesdeclast_si128(b, k[10]);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_xor_si128(b, prev));
+    prev = c;
+    in += 16;
+    out += 16;
+  }
+}
+
+} // namespace Crypto
+
+#endif
@@ -0,0 +1,97 @@
+// VAES/AVX-512 kernels, processing four blocks per register. This file is
+// compiled with VAES and AVX-512 enabled and must only be entered after
+// checking the CPU features. Remaining blocks go to the AES-NI kernels.
+
+#include "core/crypto/aes_kernels.h"
+
+#ifdef AES_X86_KERNELS
+#include <immintrin.h>
+
+namespace Crypto {
+
+// 4 registers with 4 blocks each
+constexpr std::size_t k_vaes_blocks = 16;
+
+static inline __m512i BroadcastKey(const byte *key) {
+  return _mm512_broadcast_i32x4(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(key)));
+}
+
+void AesCtrVaes(const Aes128::RoundKeys &keys, u64 counter_high,
+                u64 counter_low, const byte *in, byte *out,
+                std::size_t blocks) {
+  __m512i k[11];
+  for (unsigned r = 0; r < 11; ++r)
+    k[r] = BroadcastKey(keys.enc + r * 16);
+
+  alignas(64) u64 counters[k_vaes_blocks * 2];
+  while (blocks >= k_vaes_blocks) {
+    for (std::size_t i = 0; i < k_vaes_blocks; ++i) {
+      counters[i * 2] = swap64(counter_high);
+      counters[i * 2 + 1] = swap64(counter_low);
+      if (++counter_low == 0)
+        ++counter_high;
+    }
+
+    __m512i b[4];
+    for (unsigned j = 0; j < 4; ++j)
+      b[j] = _mm512_xor_si512(_mm512_load_si512(counters + j * 8), k[0]);
+    for (unsigned r = 1; r < 10; ++r)
+      for (unsigned j = 0; j < 4; ++j)
+        b[j] = _mm512_aesenc_epi128(b[j], k[r]);
+    for (unsigned j = 0; j < 4; ++j) {
+      b[j] = _mm512_aesenclast_epi128(b[j], k[10]);
+      __m512i data = _mm512_loadu_si512(in + j * 64);
+      _mm512_storeu_si512(out + j * 64, _mm512_xor_si512(data, b[j]));
+    }
+    in += k_vaes_blocks * 16;
+    out += k_vaes_blocks * 16;
+    blocks -= k_vaes_blocks;
+  }
+
+  if (blocks != 0)
+    AesCtrAesNi(keys, counter_high, counter_low, in, out, blocks);
+}
+
+void AesCbcDecryptVaes(const Aes128::RoundKeys &keys, const byte *iv,
+                       const byte *in, byte *out, std::size_t blocks) {
+  __m512i k[11];
+  for (unsigned r = 0; r < 11; ++r)
+    k[r] = BroadcastKey(keys.dec + r * 16);
+
+  // the previous ciphertext block lives in the top lane of last
+  __m512i last = _mm512_broadcast_i32x4(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(iv)));
+  while (blocks >= k_vaes_blocks) {
+    __m512i c[4], b[4];
+    for (unsigned j = 0; j < 4; ++j) {
+      c[j] = _mm512_loadu_si512(in + j * 64);
+      b[j] = _mm512_xor_si512(c[j], k[0]);
+    }
+    for (unsigned r = 1; r < 10; ++r)
+      for (unsigned j = 0; j < 4; ++j)
+        b[j] = _mm512_aesdec_epi128(b[j], k[r]);
+    for (unsigned j = 0; j < 4; ++j) {
+      b[j] = _mm512_aesdeclast_epi128(b[j], k[10]);
+      // the ciphertext shifted by one block: the top block of the register
+      // before followed by the lower three blocks of this one
+      __m512i prev = _mm512_alignr_epi64(c[j], j == 0 ? last : c[j - 1], 6);
+      _mm512_storeu_si512(out + j * 64, _mm512_xor_si512(b[j], prev));
+    }
+    last = c[3];
+    in += k_vaes_blocks * 16;
+    out += k_vaes_blocks * 16;
+    blocks -= k_vaes_blocks;
+  }
+
+  if (blocks != 0) {
+    byte prev[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(prev),
+                     _mm512_extracti32x4_epi32(last, 3));
+    AesCbcDecryptAesNi(keys, prev, in, out, blocks);
+  }
+}
+
+} // namespace Crypto
+
+#endif
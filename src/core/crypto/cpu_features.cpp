@@ -0,0 +1,75 @@
+#include "core/crypto/cpu_features.h"
+#include "core/common_types.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_FEATURES_X86
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define CPU_FEATURES_X86
+#endif
+
+namespace Crypto {
+
+#ifdef CPU_FEATURES_X86
+static void CpuId(u32 leaf, u32 subleaf, u32 regs[4]) {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuidex(info, (int)leaf, (int)subleaf);
+  for (int i = 0; i < 4; ++i)
+    regs[i] = (u32)info[i];
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static u64 XGetBv() {
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  u32 eax, edx;
+  __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((u64)edx << 32) | eax;
+#endif
+}
+
+static CpuFeatures DetectCpuFeatures() {
+  CpuFeatures features;
+  u32 regs[4];
+  CpuId(0, 0, regs);
+  u32 max_leaf = regs[0];
+  if (max_leaf < 1)
+    return features;
+
+  CpuId(1, 0, regs);
+  features.ssse3 = (regs[2] >> 9) & 1;
+  features.sse41 = (regs[2] >> 19) & 1;
+  features.aes_ni = (regs[2] >> 25) & 1;
+  bool os_xsave = (regs[2] >> 27) & 1;
+  bool avx = (regs[2] >> 28) & 1;
+
+  // XMM/YMM state (bits 1-2) and opmask/ZMM state (bits 5-7)
+  u64 xcr0 = os_xsave ? XGetBv() : 0;
+  bool os_avx = (xcr0 & 0x6) == 0x6;
+  bool os_avx512 = os_avx && (xcr0 & 0xE0) == 0xE0;
+
+  if (max_leaf >= 7) {
+    CpuId(7, 0, regs);
+    features.avx2 = avx && os_avx && ((regs[1] >> 5) & 1);
+    features.avx512 =
+        os_avx512 && ((regs[1] >> 16) & 1) && ((regs[1] >> 30) & 1);
+    features.vaes = features.avx512 && ((regs[2] >> 9) & 1);
+    features.sha_ni = (regs[1] >> 29) & 1;
+  }
+  return features;
+}
+#else
+static CpuFeatures DetectCpuFeatures() { return {}; }
+#endif
+
+const CpuFeatures &GetCpuFeatures() {
+  static const CpuFeatures features = DetectCpuFeatures();
+  return features;
+}
+
+} // namespace Crypto
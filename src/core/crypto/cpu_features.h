@@ -0,0 +1,19 @@
+#pragma once
+
+namespace Crypto {
+
+// Instruction set extensions usable by the crypto kernels. The extended
+// register state is only reported if the OS saves it.
+struct CpuFeatures {
+  bool aes_ni = false;
+  bool ssse3 = false;
+  bool sse41 = false;
+  bool avx2 = false;
+  bool avx512 = false; // AVX-512 F and BW
+  bool vaes = false;   // VAES with AVX-512
+  bool sha_ni = false;
+};
+
+const CpuFeatures &GetCpuFeatures();
+
+} // namespace Crypto
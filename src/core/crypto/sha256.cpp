@@ -0,0 +1,194 @@
+#include "core/crypto/sha256.h"
+#include "core/crypto/cpu_features.h"
+#include "core/crypto/sha256_kernels.h"
+#include <algorithm>
+
+namespace Crypto {
+
+const u32 k_sha256_round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const u32 k_sha256_initial_state[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static u32 Ror(u32 value, unsigned shift) {
+  return (value >> shift) | (value << (32 - shift));
+}
+
+static u32 LoadBe(const byte *p) {
+  return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | (u32)p[3];
+}
+
+static void StoreBe(byte *p, u32 value) {
+  p[0] = (byte)(value >> 24);
+  p[1] = (byte)(value >> 16);
+  p[2] = (byte)(value >> 8);
+  p[3] = (byte)value;
+}
+
+void Sha256CompressPortable(u32 state[8], const byte *data,
+                            std::size_t blocks) {
+  for (; blocks != 0; --blocks, data += 64) {
+    u32 w[64];
+    for (unsigned t = 0; t < 16; ++t)
+      w[t] = LoadBe(data + t * 4);
+    for (unsigned t = 16; t < 64; ++t) {
+      u32 s0 = Ror(w[t - 15], 7) ^ Ror(w[t - 15], 18) ^ (w[t - 15] >> 3);
+      u32 s1 = Ror(w[t - 2], 17) ^ Ror(w[t - 2], 19) ^ (w[t - 2] >> 10);
+      w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+    }
+
+    u32 a = state[0], b = state[1], c = state[2], d = state[3];
+    u32 e = state[4], f = state[5], g = state[6], h = state[7];
+    for (unsigned t = 0; t < 64; ++t) {
+      u32 sum1 = Ror(e, 6) ^ Ror(e, 11) ^ Ror(e, 25);
+      u32 ch = (e & f) ^ (~e & g);
+      u32 t1 = h + sum1 + ch + k_sha256_round_constants[t] + w[t];
+      u32 sum0 = Ror(a, 2) ^ Ror(a, 13) ^ Ror(a, 22);
+      u32 maj = (a & b) | (c & (a | b));
+      u32 t2 = sum0 + maj;
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+struct Sha256KernelSet {
+  Sha256CompressKernel compress;
+  const char *name;
+
+  // null if hashing messages one by one is faster
+  Sha256MultiKernel multi;
+  std::size_t lanes;
+  const char *multi_name;
+};
+
+static Sha256KernelSet SelectKernels() {
+  Sha256KernelSet kernels{Sha256CompressPortable, "portable", nullptr, 0,
+                          "none"};
+#ifdef SHA256_X86_KERNELS
+  const CpuFeatures &features = GetCpuFeatures();
+  if (features.sha_ni && features.sse41) {
+    // a single SHA-NI stream outruns eight AVX2 lanes
+    kernels.compress = Sha256CompressShaNi;
+    kernels.name = "SHA-NI";
+  } else if (features.avx2) {
+    kernels.multi = Sha256MultiAvx2;
+    kernels.lanes = k_sha256_avx2_lanes;
+    kernels.multi_name = "AVX2 x8";
+  } else {
+    kernels.multi = Sha256MultiSse2;
+    kernels.lanes = k_sha256_sse2_lanes;
+    kernels.multi_name = "SSE2 x4";
+  }
+#endif
+  return kernels;
+}
+
+static const Sha256KernelSet &GetKernels() {
+  static const Sha256KernelSet kernels = SelectKernels();
+  return kernels;
+}
+
+Sha256::Sha256() { Reset(); }
+
+void Sha256::Reset() {
+  std::copy(k_sha256_initial_state, k_sha256_initial_state + 8, state);
+  buffered = 0;
+  length = 0;
+}
+
+void Sha256::Update(const byte *data, std::size_t size) {
+  Sha256CompressKernel compress = GetKernels().compress;
+  length += size;
+  if (buffered != 0) {
+    std::size_t part = std::min(size, 64 - buffered);
+    std::memcpy(buffer + buffered, data, part);
+    buffered += part;
+    data += part;
+    size -= part;
+    if (buffered != 64)
+      return;
+    compress(state, buffer, 1);
+    buffered = 0;
+  }
+
+  std::size_t blocks = size / 64;
+  if (blocks != 0) {
+    compress(state, data, blocks);
+    data += blocks * 64;
+    size -= blocks * 64;
+  }
+
+  if (size != 0)
+    std::memcpy(buffer, data, size);
+  buffered = size;
+}
+
+Sha256Digest Sha256::Final() {
+  byte tail[128] = {};
+  std::memcpy(tail, buffer, buffered);
+  tail[buffered] = byte{0x80};
+  std::size_t tail_size = buffered + 9 > 64 ? 128 : 64;
+  u64 bits = length * 8;
+  for (unsigned i = 0; i < 8; ++i)
+    tail[tail_size - 1 - i] = (byte)(bits >> (i * 8));
+  GetKernels().compress(state, tail, tail_size / 64);
+
+  Sha256Digest digest;
+  for (unsigned i = 0; i < 8; ++i)
+    StoreBe(digest.data() + i * 4, state[i]);
+  Reset();
+  return digest;
+}
+
+Sha256Digest Sha256::Digest(const byte *data, std::size_t size) {
+  Sha256 sha;
+  sha.Update(data, size);
+  return sha.Final();
+}
+
+void Sha256::DigestBlocks(const byte *data, std::size_t message_size,
+                          std::size_t count, Sha256Digest *digests) {
+  const Sha256KernelSet &kernels = GetKernels();
+  std::size_t i = 0;
+  if (kernels.multi) {
+    for (; i + kernels.lanes <= count; i += kernels.lanes)
+      kernels.multi(data + i * message_size, message_size, digests + i);
+  }
+  for (; i < count; ++i)
+    digests[i] = Digest(data + i * message_size, message_size);
+}
+
+const char *Sha256::KernelName() { return GetKernels().name; }
+
+const char *Sha256::MultiKernelName() { return GetKernels().multi_name; }
+
+} // namespace Crypto
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "core/common_types.h"
+
+namespace Crypto {
+
+constexpr std::size_t SHA256_DIGEST_SIZE = 32;
+
+using Sha256Digest = std::array<byte, SHA256_DIGEST_SIZE>;
+
+// Incremental SHA-256. The compression function runs on SHA-NI if the CPU
+// has it and on portable C++ otherwise, chosen once at runtime.
+class Sha256 {
+public:
+  Sha256();
+
+  void Update(const byte *data, std::size_t size);
+
+  // Returns the digest and resets the state for a new message
+  Sha256Digest Final();
+
+  static Sha256Digest Digest(const byte *data, std::size_t size);
+
+  // Hashes count independent messages of message_size bytes each, stored
+  // back to back at data, into digests[0..count). Several messages are
+  // hashed in lockstep in SIMD lanes where that is faster than hashing them
+  // one by one, which suits hash trees with many small blocks.
+  static void DigestBlocks(const byte *data, std::size_t message_size,
+                           std::size_t count, Sha256Digest *digests);
+
+  // Names of the kernels in use, for diagnostics
+  static const char *KernelName();
+  static const char *MultiKernelName();
+
+private:
+  void Reset();
+
+  u32 state[8];
+  byte buffer[64];
+  std::size_t buffered;
+  u64 length;
+};
+
+} // namespace Crypto
@@ -0,0 +1,38 @@
+// Eight lane SHA-256 on AVX2. This file is compiled with AVX2 enabled and must
+// only be entered after checking the CPU features.
+
+#include "core/crypto/sha256_kernels.h"
+
+#ifdef SHA256_X86_KERNELS
+#include "core/crypto/sha256_lanes.h"
+#include <immintrin.h>
+
+namespace Crypto {
+
+struct Avx2Lanes {
+  using Vec = __m256i;
+  static constexpr std::size_t lanes = k_sha256_avx2_lanes;
+
+  static Vec Set1(u32 x) { return _mm256_set1_epi32((int)x); }
+  static Vec Load(const u32 *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+  }
+  static void Store(u32 *p, Vec v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+  }
+  static Vec Add(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+  static Vec Xor(Vec a, Vec b) { return _mm256_xor_si256(a, b); }
+  static Vec And(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+  static Vec AndNot(Vec a, Vec b) { return _mm256_andnot_si256(a, b); }
+  static Vec Or(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+  template <int n> static Vec Shr(Vec v) { return _mm256_srli_epi32(v, n); }
+  template <int n> static Vec Shl(Vec v) { return _mm256_slli_epi32(v, n); }
+};
+
+void Sha256MultiAvx2(const byte *data, std::size_t message_size,
+                     Sha256Digest *digests) {
+  Sha256Lanes<Avx2Lanes>(data, message_size, digests);
+}
+
+} // namespace Crypto
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "core/crypto/sha256.h"
+
+// Internal interface between Sha256 and its instruction set specific kernels
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SHA256_X86_KERNELS
+#endif
+
+namespace Crypto {
+
+// Runs the compression function over blocks 64-byte blocks
+using Sha256CompressKernel = void (*)(u32 state[8], const byte *data,
+                                      std::size_t blocks);
+
+// Hashes a fixed number of messages of message_size bytes in lockstep. The
+// messages are at data + i * message_size.
+using Sha256MultiKernel = void (*)(const byte *data, std::size_t message_size,
+                                   Sha256Digest *digests);
+
+extern const u32 k_sha256_round_constants[64];
+extern const u32 k_sha256_initial_state[8];
+
+void Sha256CompressPortable(u32 state[8], const byte *data,
+                            std::size_t blocks);
+
+#ifdef SHA256_X86_KERNELS
+void Sha256CompressShaNi(u32 state[8], const byte *data, std::size_t blocks);
+
+constexpr std::size_t k_sha256_sse2_lanes = 4;
+constexpr std::size_t k_sha256_avx2_lanes = 8;
+void Sha256MultiSse2(const byte *data, std::size_t message_size,
+                     Sha256Digest *digests);
+void Sha256MultiAvx2(const byte *data, std::size_t message_size,
+                     Sha256Digest *digests);
+#endif
+
+} // namespace Crypto
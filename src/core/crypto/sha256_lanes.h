@@ -0,0 +1,132 @@
+#pragma once
+
+// Multi-buffer SHA-256 shared by the SIMD lane kernels. A kernel source file
+// defines a traits type for its vector registers and instantiates
+// Sha256Lanes with it. Everything here has internal linkage, so each kernel
+// keeps the code generated for its own instruction set.
+//
+// The traits type provides: Vec, lanes, Set1, Load, Store, Add, Xor, And,
+// AndNot (~a & b), Or, Shr<n> and Shl<n>, all on 32-bit lanes.
+
+#include "core/crypto/sha256_kernels.h"
+#include <cstring>
+
+namespace Crypto {
+
+static inline u32 LanesLoadBe(const byte *p) {
+  return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | (u32)p[3];
+}
+
+static inline void LanesStoreBe(byte *p, u32 value) {
+  p[0] = (byte)(value >> 24);
+  p[1] = (byte)(value >> 16);
+  p[2] = (byte)(value >> 8);
+  p[3] = (byte)value;
+}
+
+template <typename V, int n>
+static inline typename V::Vec LanesRotr(typename V::Vec x) {
+  return V::Or(V::template Shr<n>(x), V::template Shl<32 - n>(x));
+}
+
+// Runs the compression function on one 64-byte block per lane
+template <typename V>
+static void LanesCompress(typename V::Vec s[8],
+                          const byte *const blocks[V::lanes]) {
+  using Vec = typename V::Vec;
+  Vec w[16];
+  Vec a = s[0], b = s[1], c = s[2], d = s[3];
+  Vec e = s[4], f = s[5], g = s[6], h = s[7];
+  for (unsigned t = 0; t < 64; ++t) {
+    Vec wt;
+    if (t < 16) {
+      u32 words[V::lanes];
+      for (std::size_t l = 0; l < V::lanes; ++l)
+        words[l] = LanesLoadBe(blocks[l] + t * 4);
+      wt = V::Load(words);
+    } else {
+      Vec w15 = w[(t - 15) & 15];
+      Vec w2 = w[(t - 2) & 15];
+      Vec s0 = V::Xor(V::Xor(LanesRotr<V, 7>(w15), LanesRotr<V, 18>(w15)),
+                      V::template Shr<3>(w15));
+      Vec s1 = V::Xor(V::Xor(LanesRotr<V, 17>(w2), LanesRotr<V, 19>(w2)),
+                      V::template Shr<10>(w2));
+      wt = V::Add(V::Add(w[t & 15], s0), V::Add(w[(t - 7) & 15], s1));
+    }
+    w[t & 15] = wt;
+
+    Vec sum1 = V::Xor(V::Xor(LanesRotr<V, 6>(e), LanesRotr<V, 11>(e)),
+                      LanesRotr<V, 25>(e));
+    Vec ch = V::Xor(V::And(e, f), V::AndNot(e, g));
+    Vec t1 = V::Add(V::Add(h, sum1),
+                    V::Add(V::Add(ch, V::Set1(k_sha256_round_constants[t])),
+                           wt));
+    Vec sum0 = V::Xor(V::Xor(LanesRotr<V, 2>(a), LanesRotr<V, 13>(a)),
+                      LanesRotr<V, 22>(a));
+    Vec maj = V::Or(V::And(a, b), V::And(c, V::Or(a, b)));
+    Vec t2 = V::Add(sum0, maj);
+    h = g;
+    g = f;
+    f = e;
+    e = V::Add(d, t1);
+    d = c;
+    c = b;
+    b = a;
+    a = V::Add(t1, t2);
+  }
+  s[0] = V::Add(s[0], a);
+  s[1] = V::Add(s[1], b);
+  s[2] = V::Add(s[2], c);
+  s[3] = V::Add(s[3], d);
+  s[4] = V::Add(s[4], e);
+  s[5] = V::Add(s[5], f);
+  s[6] = V::Add(s[6], g);
+  s[7] = V::Add(s[7], h);
+}
+
+// Hashes V::lanes messages of equal size. As the sizes are equal, all lanes
+// take the same number of blocks including the padding.
+template <typename V>
+static void Sha256Lanes(const byte *data, std::size_t message_size,
+                        Sha256Digest *digests) {
+  using Vec = typename V::Vec;
+  constexpr std::size_t lanes = V::lanes;
+
+  Vec s[8];
+  for (unsigned i = 0; i < 8; ++i)
+    s[i] = V::Set1(k_sha256_initial_state[i]);
+
+  const byte *blocks[lanes];
+  std::size_t full_blocks = message_size / 64;
+  for (std::size_t block = 0; block < full_blocks; ++block) {
+    for (std::size_t l = 0; l < lanes; ++l)
+      blocks[l] = data + l * message_size + block * 64;
+    LanesCompress<V>(s, blocks);
+  }
+
+  std::size_t rest = message_size % 64;
+  std::size_t tail_blocks = rest + 9 > 64 ? 2 : 1;
+  u64 bits = (u64)message_size * 8;
+  byte tail[lanes][128];
+  for (std::size_t l = 0; l < lanes; ++l) {
+    std::memset(tail[l], 0, sizeof(tail[l]));
+    std::memcpy(tail[l], data + l * message_size + full_blocks * 64, rest);
+    tail[l][rest] = byte{0x80};
+    for (unsigned i = 0; i < 8; ++i)
+      tail[l][tail_blocks * 64 - 1 - i] = (byte)(bits >> (i * 8));
+  }
+  for (std::size_t block = 0; block < tail_blocks; ++block) {
+    for (std::size_t l = 0; l < lanes; ++l)
+      blocks[l] = tail[l] + block * 64;
+    LanesCompress<V>(s, blocks);
+  }
+
+  for (unsigned i = 0; i < 8; ++i) {
+    u32 words[lanes];
+    V::Store(words, s[i]);
+    for (std::size_t l = 0; l < lanes; ++l)
+      LanesStoreBe(digests[l].data() + i * 4, words[l]);
+  }
+}
+
+} // namespace Crypto
@@ -0,0 +1,63 @@
+// SHA-NI kernel. This file is compiled with SHA and SSE4.1 enabled and must
+// only be entered after checking the CPU features.
+
+#include "core/crypto/sha256_kernels.h"
+
+#ifdef SHA256_X86_KERNELS
+#include <immintrin.h>
+
+namespace Crypto {
+
+void Sha256CompressShaNi(u32 state[8], const byte *data, std::size_t blocks) {
+  const __m128i byte_swap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  const __m128i *k =
+      reinterpret_cast<const __m128i *>(k_sha256_round_constants);
+
+  // the round instructions take the state as ABEF and CDGH
+  __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(state));
+  __m128i state1 =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4));
+  tmp = _mm_shuffle_epi32(tmp, 0xB1);        // CDAB
+  state1 = _mm_shuffle_epi32(state1, 0x1B);  // EFGH
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);      // CDGH
+
+  for (; blocks != 0; --blocks, data += 64) {
+    __m128i abef = state0;
+    __m128i cdgh = state1;
+    __m128i w[4];
+    for (unsigned i = 0; i < 16; ++i) {
+      __m128i &wi = w[i % 4];
+      if (i < 4) {
+        wi = _mm_shuffle_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(data) + i),
+            byte_swap);
+      } else {
+        // wi holds the words of four rounds ago
+        const __m128i &w1 = w[(i + 1) % 4];
+        const __m128i &w2 = w[(i + 2) % 4];
+        const __m128i &w3 = w[(i + 3) % 4];
+        wi = _mm_sha256msg1_epu32(wi, w1);
+        wi = _mm_add_epi32(wi, _mm_alignr_epi8(w3, w2, 4));
+        wi = _mm_sha256msg2_epu32(wi, w3);
+      }
+      __m128i msg = _mm_add_epi32(wi, _mm_loadu_si128(k + i));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+      msg = _mm_shuffle_epi32(msg, 0x0E);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    }
+    state0 = _mm_add_epi32(state0, abef);
+    state1 = _mm_add_epi32(state1, cdgh);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1B);          // FEBA
+  state1 = _mm_shuffle_epi32(state1, 0xB1);       // DCHG
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);    // DCBA
+  state1 = _mm_alignr_epi8(state1, tmp, 8);       // HGFE
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state), state0);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), state1);
+}
+
+} // namespace Crypto
+#endif
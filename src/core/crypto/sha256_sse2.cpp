@@ -0,0 +1,37 @@
+// Four lane SHA-256 on SSE2, which every x86-64 CPU has
+
+#include "core/crypto/sha256_kernels.h"
+
+#ifdef SHA256_X86_KERNELS
+#include "core/crypto/sha256_lanes.h"
+#include <emmintrin.h>
+
+namespace Crypto {
+
+struct Sse2Lanes {
+  using Vec = __m128i;
+  static constexpr std::size_t lanes = k_sha256_sse2_lanes;
+
+  static Vec Set1(u32 x) { return _mm_set1_epi32((int)x); }
+  static Vec Load(const u32 *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  }
+  static void Store(u32 *p, Vec v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+  }
+  static Vec Add(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+  static Vec Xor(Vec a, Vec b) { return _mm_xor_si128(a, b); }
+  static Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+  static Vec AndNot(Vec a, Vec b) { return _mm_andnot_si128(a, b); }
+  static Vec Or(Vec a, Vec b) { return _mm_or_si128(a, b); }
+  template <int n> static Vec Shr(Vec v) { return _mm_srli_epi32(v, n); }
+  template <int n> static Vec Shl(Vec v) { return _mm_slli_epi32(v, n); }
+};
+
+void Sha256MultiSse2(const byte *data, std::size_t message_size,
+                     Sha256Digest *digests) {
+  Sha256Lanes<Sse2Lanes>(data, message_size, digests);
+}
+
+} // namespace Crypto
+#endif
@@ -10,3 +10,11 @@ inline CryptoPP::byte *CryptoPPBytes(byte_seq &bytes) {
 inline const CryptoPP::byte *CryptoPPBytes(const byte_seq &bytes) {
   return reinterpret_cast<const CryptoPP::byte *>(bytes.data());
 }
+
+inline CryptoPP::byte *CryptoPPBytes(byte *bytes) {
+  return reinterpret_cast<CryptoPP::byte *>(bytes);
+}
+
+inline const CryptoPP::byte *CryptoPPBytes(const byte *bytes) {
+  return reinterpret_cast<const CryptoPP::byte *>(bytes);
+}
@@ -1,41 +1,143 @@
 #include "core/file_backend/aes_cbc.h"
 #include "core/align.h"
-#include "core/cryptopp_util.h"
-#include <cryptopp/aes.h>
-#include <cryptopp/modes.h>
+#include "core/thread_pool.h"
+#include <algorithm>
+#include <vector>
 
 namespace FB {
 
-AesCbcFile::AesCbcFile(FilePtr parent, FilePtr key, FilePtr iv)
-    : parent(std::move(parent)), key(std::move(key)), iv(std::move(iv)) {}
+// Reads spanning up to this many bytes (including the iv block) are served
+// from a single parent read into a stack buffer.
+constexpr std::size_t k_small_read_size = 0x200;
+
+// Bodies larger than this are decrypted in chunks on the thread pool, each
+// chained from the last ciphertext block of the chunk before it.
+constexpr std::size_t k_parallel_size = 0x400000;
+constexpr std::size_t k_parallel_chunk_size = 0x100000;
+
+AesCbcFile::AesCbcFile(FilePtr parent_, FilePtr key_, FilePtr iv_)
+    : parent(std::move(parent_)) {
+  if (key_->ReadInto(0, 16, key.data()) == 16 &&
+      iv_->ReadInto(0, 16, iv.data()) == 16) {
+    aes = std::make_unique<Crypto::Aes128>(key);
+  }
+}
 
 std::size_t AesCbcFile::GetSize() { return parent->GetSize(); }
 
-byte_seq AesCbcFile::Read(std::size_t pos, std::size_t size) {
+std::size_t AesCbcFile::ReadInto(std::size_t pos, std::size_t size,
+                                 byte *dest) {
   // Random access for CBC mode decryption is implemented here.
+  if (!aes)
+    return 0;
+  std::size_t file_size = GetSize();
+  if (pos >= file_size) {
+    return 0;
+  }
+  size = std::min(size, file_size - pos);
 
-  // read encrypted data from aligned boundary
+  // if the boundary doesn't start from the file beginning, use the previous
+  // encrypted block as iv. It is fetched in the same parent read as the data.
   std::size_t end = pos + size;
   std::size_t pos_align_down = AlignDown(pos, 16);
-  std::size_t end_align_up = std::min(AlignUp(end, 16), GetSize());
-  std::size_t size_align = end_align_up - pos_align_down;
-  auto buffer = parent->Read(pos_align_down, size_align);
+  std::size_t read_begin = pos_align_down == 0 ? 0 : pos_align_down - 16;
 
-  // if the boundary doesn't start from the file beginning, use the previous
-  // encrypted block as iv
-  auto iv_data = pos_align_down == 0 ? iv->Read(0, 16)
-                                     : parent->Read(pos_align_down - 16, 16);
-
-  // decrypt
-  auto key_data = key->Read(0, 16);
-  if (key_data.size() != 16 || iv_data.size() != 16)
-    return {};
-  CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption dec;
-  dec.SetKeyWithIV(CryptoPPBytes(key_data), 16, CryptoPPBytes(iv_data), 16);
-  dec.ProcessData(CryptoPPBytes(buffer), CryptoPPBytes(buffer), buffer.size());
-
-  // truncate the buffer to the actual boundary
-  return byte_seq(buffer.begin() + (pos - pos_align_down),
-                  buffer.end() - (end_align_up - end));
+  std::size_t read_size = AlignUp(end, 16) - read_begin;
+  if (read_size <= k_small_read_size) {
+    std::array<byte, k_small_read_size> buffer;
+    if (parent->ReadInto(read_begin, read_size, buffer.data()) != read_size)
+      return 0;
+    const byte *block_iv = pos_align_down == 0 ? iv.data() : buffer.data();
+    byte *blocks = buffer.data() + (pos_align_down - read_begin);
+    std::size_t blocks_size = read_begin + read_size - pos_align_down;
+    AESKey chain;
+    std::memcpy(chain.data(), block_iv, 16);
+    aes->CbcDecrypt(chain, blocks, blocks, blocks_size);
+    std::memcpy(dest, blocks + (pos - pos_align_down), size);
+    return size;
+  }
+
+  // large reads: the first block is decrypted on stack together with its iv.
+  // chain always holds the ciphertext block before the next one to decrypt.
+  std::array<byte, 32> head;
+  std::size_t head_size = pos_align_down + 16 - read_begin;
+  if (parent->ReadInto(read_begin, head_size, head.data()) != head_size)
+    return 0;
+  AESKey chain;
+  std::memcpy(chain.data(), pos_align_down == 0 ? iv.data() : head.data(), 16);
+  byte *first = head.data() + head_size - 16;
+  AESKey next_chain;
+  std::memcpy(next_chain.data(), first, 16);
+  aes->CbcDecrypt(chain, first, first, 16);
+  chain = next_chain;
+  std::size_t done = pos_align_down + 16 - pos;
+  std::memcpy(dest, first + (pos - pos_align_down), done);
+
+  // aligned body: read directly into the destination and decrypt in place
+  std::size_t body_size = AlignDown(size - done, 16);
+  if (body_size != 0) {
+    if (parent->ReadInto(pos + done, body_size, dest + done) != body_size)
+      return done;
+    byte *body = dest + done;
+    std::memcpy(next_chain.data(), body + body_size - 16, 16);
+    if (body_size <= k_parallel_size) {
+      aes->CbcDecrypt(chain, body, body, body_size);
+    } else {
+      // decryption is in place, so collect the chunk ivs beforehand
+      std::size_t chunks =
+          (body_size + k_parallel_chunk_size - 1) / k_parallel_chunk_size;
+      std::vector<AESKey> chunk_ivs(chunks);
+      chunk_ivs[0] = chain;
+      for (std::size_t i = 1; i < chunks; ++i)
+        std::memcpy(chunk_ivs[i].data(), body + i * k_parallel_chunk_size - 16,
+                    16);
+      ThreadPool::Global().ParallelFor(chunks, [&](std::size_t i) {
+        std::size_t offset = i * k_parallel_chunk_size;
+        std::size_t chunk_size =
+            std::min(k_parallel_chunk_size, body_size - offset);
+        aes->CbcDecrypt(chunk_ivs[i], body + offset, body + offset,
+                        chunk_size);
+      });
+    }
+    chain = next_chain;
+    done += body_size;
+  }
+
+  // unaligned tail
+  if (done != size) {
+    std::array<byte, 16> block;
+    if (parent->ReadInto(pos + done, 16, block.data()) != 16)
+      return done;
+    aes->CbcDecrypt(chain, block.data(), block.data(), 16);
+    std::memcpy(dest + done, block.data(), size - done);
+    done = size;
+  }
+
+  return done;
+}
+
+bool AesCbcFile::GetSplit(SplitFile &split) {
+  if (!aes)
+    return false;
+  split.raw = parent;
+  split.offset = 0;
+  split.alignment = 16;
+  split.lead = 16;
+  split.decrypt = [this](std::size_t pos, byte *data, std::size_t size) {
+    AESKey chain;
+    std::memcpy(chain.data(), pos == 0 ? iv.data() : data - 16, 16);
+    aes->CbcDecrypt(chain, data, data, size);
+  };
+  return true;
 }
-} // namespace FB
\ No newline at end of file
+
+bool AesCbcFile::GetOrigin(FileOrigin &origin) {
+  if (!aes || !parent->GetOrigin(origin))
+    return false;
+  byte_seq parameters(key.begin(), key.end());
+  parameters.insert(parameters.end(), iv.begin(), iv.end());
+  origin.Derive("aes-cbc", parameters);
+  return true;
+}
+
+} // namespace FB
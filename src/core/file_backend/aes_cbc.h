@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/crypto/aes.h"
 #include "core/file_backend/file.h"
 
 namespace FB {
@@ -9,12 +10,18 @@ public:
   AesCbcFile(FilePtr parent, FilePtr key, FilePtr iv);
 
   std::size_t GetSize() override;
-  byte_seq Read(std::size_t pos, std::size_t size) override;
+  std::size_t ReadInto(std::size_t pos, std::size_t size, byte *dest) override;
+  bool GetSplit(SplitFile &split) override;
+  bool GetOrigin(FileOrigin &origin) override;
 
 private:
   FilePtr parent;
-  FilePtr key;
-  FilePtr iv;
+
+  // key schedule and iv, set up once at construction. aes is null if the key
+  // or the iv is not valid.
+  std::unique_ptr<Crypto::Aes128> aes;
+  AESKey key;
+  AESKey iv;
 };
 
-} // namespace FB
\ No newline at end of file
+} // namespace FB
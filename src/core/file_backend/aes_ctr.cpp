@@ -1,25 +1,64 @@
 #include "core/file_backend/aes_ctr.h"
-#include "core/cryptopp_util.h"
-#include <cryptopp/aes.h>
-#include <cryptopp/modes.h>
-#include <cstdio>
+#include "core/thread_pool.h"
+#include <algorithm>
+
 namespace FB {
 
-AesCtrFile::AesCtrFile(FilePtr parent, FilePtr key, FilePtr iv)
-    : parent(std::move(parent)), key(std::move(key)), iv(std::move(iv)) {}
+// Reads larger than this are decrypted in chunks on the thread pool. Every
+// chunk computes its own counter from its offset.
+constexpr std::size_t k_parallel_size = 0x400000;
+constexpr std::size_t k_parallel_chunk_size = 0x100000;
+
+AesCtrFile::AesCtrFile(FilePtr parent_, FilePtr key_, FilePtr iv_)
+    : parent(std::move(parent_)) {
+  if (key_->ReadInto(0, 16, key.data()) == 16 &&
+      iv_->ReadInto(0, 16, iv.data()) == 16) {
+    aes = std::make_unique<Crypto::Aes128>(key);
+  }
+}
 
 std::size_t AesCtrFile::GetSize() { return parent->GetSize(); }
 
-byte_seq AesCtrFile::Read(std::size_t pos, std::size_t size) {
-  auto buffer = parent->Read(pos, size);
-  auto key_data = key->Read(0, 16);
-  auto iv_data = iv->Read(0, 16);
-  if (key_data.size() != 16 || iv_data.size() != 16)
-    return {};
-  CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption dec;
-  dec.SetKeyWithIV(CryptoPPBytes(key_data), 16, CryptoPPBytes(iv_data), 16);
-  dec.Seek(pos);
-  dec.ProcessData(CryptoPPBytes(buffer), CryptoPPBytes(buffer), buffer.size());
-  return buffer;
+std::size_t AesCtrFile::ReadInto(std::size_t pos, std::size_t size,
+                                 byte *dest) {
+  if (!aes)
+    return 0;
+  size = parent->ReadInto(pos, size, dest);
+  if (size <= k_parallel_size) {
+    aes->CtrXor(iv, pos, dest, dest, size);
+    return size;
+  }
+
+  std::size_t chunks =
+      (size + k_parallel_chunk_size - 1) / k_parallel_chunk_size;
+  ThreadPool::Global().ParallelFor(chunks, [&](std::size_t i) {
+    std::size_t offset = i * k_parallel_chunk_size;
+    std::size_t chunk_size = std::min(k_parallel_chunk_size, size - offset);
+    aes->CtrXor(iv, pos + offset, dest + offset, dest + offset, chunk_size);
+  });
+  return size;
 }
-} // namespace FB
\ No newline at end of file
+
+bool AesCtrFile::GetSplit(SplitFile &split) {
+  if (!aes)
+    return false;
+  split.raw = parent;
+  split.offset = 0;
+  split.alignment = 1;
+  split.lead = 0;
+  split.decrypt = [this](std::size_t pos, byte *data, std::size_t size) {
+    aes->CtrXor(iv, pos, data, data, size);
+  };
+  return true;
+}
+
+bool AesCtrFile::GetOrigin(FileOrigin &origin) {
+  if (!aes || !parent->GetOrigin(origin))
+    return false;
+  byte_seq parameters(key.begin(), key.end());
+  parameters.insert(parameters.end(), iv.begin(), iv.end());
+  origin.Derive("aes-ctr", parameters);
+  return true;
+}
+
+} // namespace FB
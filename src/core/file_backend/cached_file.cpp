@@ -0,0 +1,160 @@
+#include "core/file_backend/cached_file.h"
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace FB {
+
+class BlockCache {
+public:
+  using Block = std::shared_ptr<const byte_seq>;
+
+  Block Find(u64 file_id, u64 index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = map.find({file_id, index});
+    if (found == map.end())
+      return nullptr;
+    lru.splice(lru.begin(), lru, found->second);
+    return found->second->block;
+  }
+
+  void Insert(u64 file_id, u64 index, Block block) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Key key{file_id, index};
+    if (map.count(key))
+      return; // another thread loaded it in the meantime
+    usage += block->size();
+    lru.push_front({key, std::move(block)});
+    map.emplace(key, lru.begin());
+    Trim();
+  }
+
+  void Purge(u64 file_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto iter = lru.begin(); iter != lru.end();) {
+      if (iter->key.file_id == file_id) {
+        usage -= iter->block->size();
+        map.erase(iter->key);
+        iter = lru.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+
+  void SetBudget(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    budget = bytes;
+    Trim();
+  }
+
+  std::atomic<u64> hits{0}, misses{0};
+
+private:
+  struct Key {
+    u64 file_id;
+    u64 index;
+    bool operator==(const Key &other) const {
+      return file_id == other.file_id && index == other.index;
+    }
+  };
+
+  struct KeyHash {
+    std::size_t operator()(const Key &key) const {
+      return std::hash<u64>()(key.file_id * 0x9E3779B97F4A7C15ULL ^ key.index);
+    }
+  };
+
+  struct Entry {
+    Key key;
+    Block block;
+  };
+
+  void Trim() {
+    while (usage > budget && !lru.empty()) {
+      usage -= lru.back().block->size();
+      map.erase(lru.back().key);
+      lru.pop_back();
+    }
+  }
+
+  std::mutex mutex;
+  std::list<Entry> lru;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> map;
+  std::size_t usage = 0;
+  std::size_t budget = 64 * 0x100000;
+};
+
+static BlockCache g_block_cache;
+static std::atomic<u64> g_next_file_id{0};
+
+CachedFile::CachedFile(FilePtr parent)
+    : parent(std::move(parent)), id(g_next_file_id++) {}
+
+CachedFile::~CachedFile() { g_block_cache.Purge(id); }
+
+std::size_t CachedFile::GetSize() { return parent->GetSize(); }
+
+bool CachedFile::GetSplit(SplitFile &split) { return parent->GetSplit(split); }
+
+bool CachedFile::GetOrigin(FileOrigin &origin) {
+  return parent->GetOrigin(origin);
+}
+
+std::size_t CachedFile::ReadInto(std::size_t pos, std::size_t size,
+                                 byte *dest) {
+  std::size_t file_size = GetSize();
+  if (pos >= file_size) {
+    return 0;
+  }
+  size = std::min(size, file_size - pos);
+
+  if (size >= bypass_size) {
+    return parent->ReadInto(pos, size, dest);
+  }
+
+  std::size_t done = 0;
+  while (done != size) {
+    u64 index = (pos + done) / block_size;
+    std::size_t block_pos = (std::size_t)(index * block_size);
+
+    std::size_t length = std::min(block_size, file_size - block_pos);
+    auto block = g_block_cache.Find(id, index);
+    if (block) {
+      ++hits;
+      ++g_block_cache.hits;
+    } else {
+      ++misses;
+      ++g_block_cache.misses;
+      auto loaded = std::make_shared<byte_seq>(length);
+      loaded->resize(parent->ReadInto(block_pos, length, loaded->data()));
+      block = loaded;
+      // a short read may be a passing failure, so it is returned but not kept
+      if (block->size() == length)
+        g_block_cache.Insert(id, index, block);
+    }
+
+    std::size_t offset = pos + done - block_pos;
+    if (offset >= block->size())
+      break;
+    std::size_t copy_size = std::min(size - done, block->size() - offset);
+    std::memcpy(dest + done, block->data() + offset, copy_size);
+    done += copy_size;
+    if (block->size() != length)
+      break;
+  }
+  return done;
+}
+
+CachedFile::Stats CachedFile::GetStats() const { return {hits, misses}; }
+
+void CachedFile::SetBudget(std::size_t bytes) {
+  g_block_cache.SetBudget(bytes);
+}
+
+CachedFile::Stats CachedFile::GetGlobalStats() {
+  return {g_block_cache.hits, g_block_cache.misses};
+}
+
+} // namespace FB
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "core/file_backend/file.h"
+#include <atomic>
+
+namespace FB {
+
+// Keeps fixed-size aligned blocks of the parent file in a process-wide LRU
+// cache. This is meant for decrypted views that are read over and over in
+// small pieces, such as RomFS metadata and IVFC hash levels. Large reads
+// bypass the cache so that streaming doesn't evict everything else.
+class CachedFile : public File {
+public:
+  static constexpr std::size_t block_size = 0x4000;
+  static constexpr std::size_t bypass_size = 0x100000;
+
+  struct Stats {
+    u64 hits;
+    u64 misses;
+  };
+
+  CachedFile(FilePtr parent);
+  ~CachedFile();
+
+  std::size_t GetSize() override;
+  std::size_t ReadInto(std::size_t pos, std::size_t size, byte *dest) override;
+  bool GetSplit(SplitFile &split) override;
+  bool GetOrigin(FileOrigin &origin) override;
+
+  Stats GetStats() const;
+
+  // Sets the memory budget shared by all cached files. Excess blocks are
+  // evicted immediately.
+  static void SetBudget(std::size_t bytes);
+  static Stats GetGlobalStats();
+
+private:
+  FilePtr parent;
+  u64 id;
+  std::atomic<u64> hits{0}, misses{0};
+};
+
+} // namespace FB
@@ -1,57 +1,174 @@
 #include "core/file_backend/disk_file.h"
 #include <algorithm>
-#include <cstdio>
-#include <mutex>
+#include <utility>
 
-// FIXME
-#define safe_fseek std::fseek
-#define safe_fread std::fread
-#define safe_ftell std::ftell
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace FB {
 
+// Reads with explicit positions instead of seeking a shared stream, so
+// concurrent readers don't need any lock.
 class DiskFile : public File {
 public:
-  DiskFile(std::FILE *stream, std::size_t file_size)
-      : stream(stream), file_size(file_size) {}
-  ~DiskFile() { std::fclose(stream); }
+#ifdef _WIN32
+  using Handle = HANDLE;
+#else
+  using Handle = int;
+#endif
+
+  DiskFile(Handle handle, std::size_t file_size, bool has_identity,
+           FileIdentity identity)
+      : handle(handle), file_size(file_size), has_identity(has_identity),
+        identity(std::move(identity)) {}
+  ~DiskFile() {
+#ifdef _WIN32
+    CloseHandle(handle);
+#else
+    close(handle);
+#endif
+  }
 
   std::size_t GetSize() override { return file_size; }
 
-  byte_seq Read(std::size_t pos, std::size_t size) override {
+  std::size_t ReadInto(std::size_t pos, std::size_t size,
+                       byte *dest) override {
     if (pos >= file_size) {
-      return {};
+      return 0;
     }
 
     size = std::min(size, file_size - pos);
-    byte_seq buffer(size);
 
-    {
-      std::lock_guard<std::mutex> lock(stream_mutex);
-      safe_fseek(stream, pos, SEEK_SET);
-      safe_fread(buffer.data(), size, 1, stream);
+    std::size_t done = 0;
+    while (done != size) {
+#ifdef _WIN32
+      u64 offset = pos + done;
+      OVERLAPPED overlapped{};
+      overlapped.Offset = (DWORD)offset;
+      overlapped.OffsetHigh = (DWORD)(offset >> 32);
+      DWORD chunk = (DWORD)std::min<std::size_t>(size - done, 0x40000000);
+      DWORD got = 0;
+      if (!ReadFile(handle, dest + done, chunk, &got, &overlapped) || got == 0)
+        break;
+#else
+      ssize_t got = pread(handle, dest + done, size - done, pos + done);
+      if (got == -1 && errno == EINTR)
+        continue;
+      if (got <= 0)
+        break;
+#endif
+      done += got;
     }
+    return done;
+  }
 
-    return buffer;
+  bool GetOrigin(FileOrigin &origin) override {
+    if (!has_identity)
+      return false;
+    origin = FileOrigin{};
+    origin.identity = identity;
+    return true;
   }
 
 private:
-  std::mutex stream_mutex;
-  std::FILE *stream;
+  Handle handle;
   std::size_t file_size;
+  bool has_identity;
+  FileIdentity identity;
 };
 
+#ifdef _WIN32
+static FileIdentity MakeIdentity(const std::string &file_name,
+                                 const BY_HANDLE_FILE_INFORMATION &info) {
+  FileIdentity identity;
+  identity.path = file_name;
+  identity.size = ((u64)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+  identity.modified = ((u64)info.ftLastWriteTime.dwHighDateTime << 32) |
+                      info.ftLastWriteTime.dwLowDateTime;
+  identity.device = info.dwVolumeSerialNumber;
+  identity.index = ((u64)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+  return identity;
+}
+#else
+static FileIdentity MakeIdentity(const std::string &file_name,
+                                 const struct stat &info) {
+  FileIdentity identity;
+  identity.path = file_name;
+  identity.size = (u64)info.st_size;
+#ifdef __APPLE__
+  const timespec &modified = info.st_mtimespec;
+#else
+  const timespec &modified = info.st_mtim;
+#endif
+  identity.modified = (u64)modified.tv_sec * 1000000000 + modified.tv_nsec;
+  identity.device = (u64)info.st_dev;
+  identity.index = (u64)info.st_ino;
+  return identity;
+}
+#endif
+
+bool GetFileIdentity(const std::string &file_name, FileIdentity &identity) {
+#ifdef _WIN32
+  // opening with no access rights only queries the attributes
+  HANDLE handle = CreateFileA(file_name.c_str(), 0,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (handle == INVALID_HANDLE_VALUE)
+    return false;
+
+  BY_HANDLE_FILE_INFORMATION info;
+  bool ok = GetFileInformationByHandle(handle, &info);
+  CloseHandle(handle);
+  if (!ok)
+    return false;
+#else
+  struct stat info;
+  if (stat(file_name.c_str(), &info) != 0)
+    return false;
+#endif
+  identity = MakeIdentity(file_name, info);
+  return true;
+}
+
 FilePtr OpenDiskFile(const std::string &file_name) {
-  std::FILE *stream = std::fopen(file_name.c_str(), "rb");
-  if (!stream)
+#ifdef _WIN32
+  HANDLE handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+  if (handle == INVALID_HANDLE_VALUE)
+    return nullptr;
+
+  BY_HANDLE_FILE_INFORMATION info;
+  if (!GetFileInformationByHandle(handle, &info)) {
+    CloseHandle(handle);
+    return nullptr;
+  }
+
+  FileIdentity identity = MakeIdentity(file_name, info);
+  return std::make_shared<DiskFile>(handle, (std::size_t)identity.size, true,
+                                    std::move(identity));
+#else
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd == -1)
     return nullptr;
 
-  // FIXME
-  safe_fseek(stream, 0, SEEK_END);
-  std::size_t size = safe_ftell(stream);
-  safe_fseek(stream, 0, SEEK_SET);
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return nullptr;
+  }
 
-  return std::make_shared<DiskFile>(stream, size);
+  // only regular files keep their identity while their data changes
+  bool regular = S_ISREG(info.st_mode);
+  return std::make_shared<DiskFile>(fd, (std::size_t)info.st_size, regular,
+                                    MakeIdentity(file_name, info));
+#endif
 }
 
-} // namespace FB
\ No newline at end of file
+} // namespace FB
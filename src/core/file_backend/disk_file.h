@@ -7,4 +7,8 @@ namespace FB {
 
 FilePtr OpenDiskFile(const std::string &file_name);
 
+// Fills identity with the current state of the file. Returns false if the
+// file can't be queried.
+bool GetFileIdentity(const std::string &file_name, FileIdentity &identity);
+
 } // namespace FB
\ No newline at end of file
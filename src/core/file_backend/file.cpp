@@ -1,8 +1,52 @@
 #include "core/file_backend/file.h"
+#include "core/crypto/sha256.h"
+#include <algorithm>
+#include <tuple>
 
 namespace FB {
 
+bool FileIdentity::operator==(const FileIdentity &other) const {
+  return std::tie(path, size, modified, device, index) ==
+         std::tie(other.path, other.size, other.modified, other.device,
+                  other.index);
+}
+
+bool FileIdentity::operator<(const FileIdentity &other) const {
+  return std::tie(path, size, modified, device, index) <
+         std::tie(other.path, other.size, other.modified, other.device,
+                  other.index);
+}
+
+void FileOrigin::Derive(const std::string &kind,
+                        const byte_seq &parameters) {
+  Crypto::Sha256 sha;
+  sha.Update(transform.data(), transform.size());
+  sha.Update(reinterpret_cast<const byte *>(&offset), sizeof(offset));
+  sha.Update(reinterpret_cast<const byte *>(kind.data()), kind.size() + 1);
+  sha.Update(parameters.data(), parameters.size());
+  auto digest = sha.Final();
+  transform.assign(digest.begin(), digest.end());
+  offset = 0;
+}
+
 File::File() = default;
 File::~File() = default;
 
-} // namespace FB
\ No newline at end of file
+byte_seq File::Read(std::size_t pos, std::size_t size) {
+  std::size_t file_size = GetSize();
+  if (pos >= file_size) {
+    return {};
+  }
+
+  byte_seq buffer(std::min(size, file_size - pos));
+  buffer.resize(ReadInto(pos, buffer.size(), buffer.data()));
+  return buffer;
+}
+
+const byte *File::View(std::size_t pos, std::size_t size) { return nullptr; }
+
+bool File::GetSplit(SplitFile &split) { return false; }
+
+bool File::GetOrigin(FileOrigin &origin) { return false; }
+
+} // namespace FB
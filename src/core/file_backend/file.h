@@ -3,11 +3,64 @@
 #include "core/common_types.h"
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace FB {
 
+class File;
+using FilePtr = std::shared_ptr<File>;
+
+// A file that decrypts data of another file in place, described as the raw
+// data plus the decryption step. This lets a pipeline read and decrypt on
+// different threads. See File::GetSplit.
+struct SplitFile {
+  // The undecrypted data and the position of this file's first byte in it
+  FilePtr raw;
+  std::size_t offset = 0;
+
+  // Ranges passed to decrypt start and end at multiples of alignment
+  // (relative to raw). If a range doesn't start at 0, the lead bytes before
+  // it must be in the buffer too.
+  std::size_t alignment = 1;
+  std::size_t lead = 0;
+
+  // Decrypts size bytes in place that were read from raw at pos. Only valid
+  // while the file that produced the split is alive.
+  std::function<void(std::size_t pos, byte *data, std::size_t size)> decrypt;
+};
+
+// A file on disk as it was when opened. If the file is modified or replaced,
+// its size, modification time or index differ.
+struct FileIdentity {
+  std::string path;
+  u64 size = 0;
+  u64 modified = 0;
+  u64 device = 0;
+  u64 index = 0;
+
+  bool operator==(const FileIdentity &other) const;
+  bool operator<(const FileIdentity &other) const;
+};
+
+// Where the data of a file comes from, for remembering results computed from
+// it. Files with equal origins have equal data while the disk file is
+// unchanged. See File::GetOrigin.
+struct FileOrigin {
+  FileIdentity identity;
+
+  // Digest of the steps (such as decryption) that turned the disk file into
+  // the data, or empty if the data is the disk file itself
+  byte_seq transform;
+  u64 offset = 0;
+
+  // Makes this the origin of data computed from the data at this origin, for
+  // example by decrypting it. parameters must determine the computation.
+  void Derive(const std::string &kind, const byte_seq &parameters);
+};
+
 class File {
 public:
   File();
@@ -20,18 +73,35 @@ public:
 
   virtual std::size_t GetSize() = 0;
 
-  virtual byte_seq Read(std::size_t pos, std::size_t size) = 0;
+  // Reads up to size bytes at pos into the caller-supplied buffer dest.
+  // Returns the number of bytes actually read.
+  virtual std::size_t ReadInto(std::size_t pos, std::size_t size,
+                               byte *dest) = 0;
+
+  byte_seq Read(std::size_t pos, std::size_t size);
+
+  // Borrows size bytes at pos directly from the backing memory (a memory
+  // mapping or an in-memory buffer) without copying. Returns nullptr if the
+  // file has no such memory or the range is out of bounds. The pointer stays
+  // valid as long as the file is alive.
+  virtual const byte *View(std::size_t pos, std::size_t size);
+
+  // Fills split and returns true if reading this file decrypts another file.
+  // Wrappers that don't change the data forward this to their parent.
+  virtual bool GetSplit(SplitFile &split);
+
+  // Fills origin and returns true if the data of this file is determined by
+  // a disk file. Wrappers that don't change the data forward this to their
+  // parent.
+  virtual bool GetOrigin(FileOrigin &origin);
 
   template <typename T> T Read(std::size_t pos) {
     static_assert(std::is_trivially_copyable<T>::value,
                   "T must be trivially copyable!");
-    T t;
-    auto raw = Read(pos, sizeof(T));
-    std::memcpy(&t, raw.data(), sizeof(T));
+    T t{};
+    ReadInto(pos, sizeof(T), reinterpret_cast<byte *>(&t));
     return t;
   }
 };
 
-using FilePtr = std::shared_ptr<File>;
-
 } // namespace FB
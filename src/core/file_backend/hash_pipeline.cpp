@@ -0,0 +1,353 @@
+#include "core/file_backend/hash_pipeline.h"
+#include "core/align.h"
+#include <algorithm>
+#include <chrono>
+
+namespace FB {
+
+using Clock = std::chrono::steady_clock;
+
+static double Seconds(Clock::duration duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+
+struct HashPipeline::Chunk {
+  std::size_t index = 0;
+  byte_seq buffer;
+
+  // The chunk's data starts at data_offset in buffer. got is how much of the
+  // size bytes requested were read (and decrypted).
+  std::size_t data_offset = 0;
+  std::size_t size = 0;
+  std::size_t got = 0;
+
+  // The range to decrypt, as raw position and offset in buffer
+  std::size_t decrypt_pos = 0;
+  std::size_t decrypt_offset = 0;
+  std::size_t decrypt_size = 0;
+};
+
+double HashPipeline::Stats::ReadUtilization() const {
+  return elapsed > 0 ? read_busy / elapsed : 0;
+}
+
+double HashPipeline::Stats::DecryptUtilization() const {
+  return elapsed > 0 && decrypt_workers != 0
+             ? decrypt_busy / (elapsed * decrypt_workers)
+             : 0;
+}
+
+double HashPipeline::Stats::HashUtilization() const {
+  return elapsed > 0 ? hash_busy / elapsed : 0;
+}
+
+HashPipeline::HashPipeline(std::size_t chunk_size, std::size_t decrypt_workers)
+    : chunk_size(chunk_size), decrypt_workers(decrypt_workers) {
+  if (this->decrypt_workers == 0) {
+    this->decrypt_workers =
+        std::max<std::size_t>(1, std::thread::hardware_concurrency() / 2);
+  }
+}
+
+HashPipeline::~HashPipeline() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cv.notify_all();
+  for (auto &thread : threads)
+    thread.join();
+}
+
+void HashPipeline::SetProgressCallback(ProgressCallback callback) {
+  progress = std::move(callback);
+}
+
+const HashPipeline::Stats &HashPipeline::GetStats() const { return stats; }
+
+void HashPipeline::StageThread(bool reader) {
+  std::unique_lock<std::mutex> lock(mutex);
+  // the threads are started before the first run, which may begin before
+  // they get here
+  std::size_t done_generation = 0;
+  for (;;) {
+    cv.wait(lock, [&] { return stop || generation != done_generation; });
+    if (stop)
+      return;
+    done_generation = generation;
+    File *source = run_source;
+    const SplitFile *split = run_split;
+    std::size_t size = run_size;
+    lock.unlock();
+
+    try {
+      if (reader)
+        Reader(*source, split, size);
+      else if (split)
+        Decryptor(*split);
+    } catch (...) {
+      Fail(std::current_exception());
+    }
+
+    lock.lock();
+    if (reader)
+      read_done = true;
+    --running;
+    cv.notify_all();
+  }
+}
+
+void HashPipeline::Fail(std::exception_ptr exception) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!error)
+      error = exception;
+    cancel = true;
+  }
+  cv.notify_all();
+}
+
+void HashPipeline::StopStages() {
+  std::unique_lock<std::mutex> lock(mutex);
+  cancel = true;
+  cv.notify_all();
+  cv.wait(lock, [this] { return running == 0; });
+}
+
+void HashPipeline::Reader(File &source, const SplitFile *split,
+                          std::size_t size) {
+  std::size_t raw_size = split ? split->raw->GetSize() : 0;
+  std::size_t pos = 0;
+  for (std::size_t index = 0; pos < size; ++index) {
+    ChunkPtr chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [this] { return cancel || !free_chunks.empty(); });
+      if (cancel)
+        break;
+      chunk = std::move(free_chunks.back());
+      free_chunks.pop_back();
+    }
+
+    auto begin = Clock::now();
+    chunk->index = index;
+    chunk->size = std::min(chunk_size, size - pos);
+    if (!split) {
+      chunk->data_offset = 0;
+      chunk->got = source.ReadInto(pos, chunk->size, chunk->buffer.data());
+    } else {
+      // widen the range to the cipher alignment, plus the lead bytes needed
+      // to decrypt the first block
+      std::size_t raw_begin = split->offset + pos;
+      std::size_t raw_end = raw_begin + chunk->size;
+      std::size_t aligned_begin = AlignDown(raw_begin, split->alignment);
+      std::size_t aligned_end =
+          std::min(AlignUp(raw_end, split->alignment), raw_size);
+      std::size_t read_begin =
+          aligned_begin == 0 ? 0 : aligned_begin - split->lead;
+      std::size_t read_end =
+          read_begin + split->raw->ReadInto(read_begin,
+                                            aligned_end - read_begin,
+                                            chunk->buffer.data());
+
+      chunk->decrypt_pos = aligned_begin;
+      chunk->decrypt_offset = aligned_begin - read_begin;
+      chunk->decrypt_size =
+          read_end > aligned_begin
+              ? AlignDown(read_end - aligned_begin, split->alignment)
+              : 0;
+      std::size_t decrypted_end = aligned_begin + chunk->decrypt_size;
+      chunk->data_offset = raw_begin - read_begin;
+      chunk->got = decrypted_end > raw_begin
+                       ? std::min(chunk->size, decrypted_end - raw_begin)
+                       : 0;
+    }
+    bool complete = chunk->got == chunk->size;
+    pos += chunk->size;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stats.read_busy += Seconds(Clock::now() - begin);
+      ++chunks_read;
+      if (split)
+        to_decrypt.push_back(std::move(chunk));
+      else
+        to_hash[index] = std::move(chunk);
+    }
+    cv.notify_all();
+    if (!complete)
+      break;
+  }
+}
+
+void HashPipeline::Decryptor(const SplitFile &split) {
+  for (;;) {
+    ChunkPtr chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock,
+              [this] { return cancel || read_done || !to_decrypt.empty(); });
+      if (cancel || to_decrypt.empty())
+        return;
+      chunk = std::move(to_decrypt.front());
+      to_decrypt.pop_front();
+    }
+
+    auto begin = Clock::now();
+    if (chunk->decrypt_size != 0) {
+      split.decrypt(chunk->decrypt_pos,
+                    chunk->buffer.data() + chunk->decrypt_offset,
+                    chunk->decrypt_size);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stats.decrypt_busy += Seconds(Clock::now() - begin);
+      to_hash[chunk->index] = std::move(chunk);
+    }
+    cv.notify_all();
+  }
+}
+
+bool HashPipeline::Run(FilePtr file, std::size_t block_size,
+                       const BlockCallback &on_block) {
+  std::size_t size = file->GetSize();
+  SplitFile split;
+  bool has_split = file->GetSplit(split);
+  std::size_t workers = has_split ? decrypt_workers : 0;
+  std::size_t slack = has_split ? 2 * split.alignment + split.lead : 0;
+
+  stats = Stats{};
+  stats.decrypt_workers = workers;
+  free_chunks.clear();
+  to_decrypt.clear();
+  to_hash.clear();
+  chunks_read = 0;
+  read_done = false;
+  cancel = false;
+  error = nullptr;
+
+  // one chunk being read, one being hashed and one queued between them, plus
+  // one per decrypt worker
+  for (std::size_t i = 0; i < workers + 3; ++i) {
+    auto chunk = std::make_unique<Chunk>();
+    chunk->buffer.resize(std::min(chunk_size, size) + slack);
+    free_chunks.push_back(std::move(chunk));
+  }
+
+  if (threads.empty()) {
+    threads.emplace_back([this] { StageThread(true); });
+    for (std::size_t i = 0; i < decrypt_workers; ++i)
+      threads.emplace_back([this] { StageThread(false); });
+  }
+
+  auto start = Clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    run_source = file.get();
+    run_split = has_split ? &split : nullptr;
+    run_size = size;
+    running = threads.size();
+    ++generation;
+  }
+  cv.notify_all();
+
+  std::size_t hashed = 0;
+  bool ok = true;
+  {
+    // however hashing ends, even by an exception from a callback, the stages
+    // are stopped before the chunks and split they use go away
+    struct StageGuard {
+      HashPipeline &pipeline;
+      ~StageGuard() { pipeline.StopStages(); }
+    } guard{*this};
+
+    Crypto::Sha256 sha;
+    std::vector<Crypto::Sha256Digest> digests;
+    std::size_t block_index = 0;
+    std::size_t block_done = 0;
+    for (std::size_t next = 0;; ++next) {
+      ChunkPtr chunk;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] {
+          return cancel || to_hash.count(next) ||
+                 (read_done && next == chunks_read);
+        });
+        auto found = to_hash.find(next);
+        if (cancel || found == to_hash.end())
+          break;
+        chunk = std::move(found->second);
+        to_hash.erase(found);
+      }
+
+      auto begin = Clock::now();
+      const byte *data = chunk->buffer.data() + chunk->data_offset;
+      std::size_t remaining = chunk->got;
+      while (remaining != 0) {
+        // whole blocks in the chunk are hashed in one go, in parallel lanes
+        // where the CPU supports it
+        if (block_done == 0 && remaining >= block_size) {
+          std::size_t count = remaining / block_size;
+          digests.resize(count);
+          Crypto::Sha256::DigestBlocks(data, block_size, count,
+                                       digests.data());
+          for (const auto &digest : digests)
+            on_block(block_index++, digest);
+          data += count * block_size;
+          remaining -= count * block_size;
+          hashed += count * block_size;
+          continue;
+        }
+
+        std::size_t part = std::min(remaining, block_size - block_done);
+        sha.Update(data, part);
+        data += part;
+        remaining -= part;
+        block_done += part;
+        hashed += part;
+        if (block_done == block_size || hashed == size) {
+          on_block(block_index++, sha.Final());
+          block_done = 0;
+        }
+      }
+      bool complete = chunk->got == chunk->size;
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.hash_busy += Seconds(Clock::now() - begin);
+        stats.bytes += chunk->got;
+        free_chunks.push_back(std::move(chunk));
+      }
+      cv.notify_all();
+
+      if (!complete || (progress && !progress(hashed, size))) {
+        ok = false;
+        break;
+      }
+    }
+  }
+  stats.elapsed = Seconds(Clock::now() - start);
+
+  if (error)
+    std::rethrow_exception(error);
+  return ok && hashed == size;
+}
+
+byte_seq HashPipeline::Sha256(FilePtr file) {
+  std::size_t size = file->GetSize();
+  byte_seq result;
+  if (size == 0) {
+    auto digest = Crypto::Sha256::Digest(nullptr, 0);
+    return byte_seq(digest.begin(), digest.end());
+  }
+  if (!Run(std::move(file), size,
+           [&](std::size_t, const Crypto::Sha256Digest &digest) {
+             result.assign(digest.begin(), digest.end());
+           })) {
+    return {};
+  }
+  return result;
+}
+
+} // namespace FB
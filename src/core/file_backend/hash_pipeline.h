@@ -0,0 +1,107 @@
+#pragma once
+
+#include "core/crypto/sha256.h"
+#include "core/file_backend/file.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace FB {
+
+// Computes SHA-256 digests of a file in three concurrent stages: an I/O thread
+// reads raw chunks, decrypt workers decrypt them in place (if the file is
+// encrypted, see SplitFile) and the calling thread hashes them in order.
+// Chunk buffers are allocated once and recycled, so at most a handful of
+// chunks are in memory at any time. The stage threads are started by the
+// first run and kept for later ones.
+class HashPipeline {
+public:
+  // Time each stage spent working. decrypt_busy is summed over all workers.
+  struct Stats {
+    double elapsed = 0;
+    double read_busy = 0;
+    double decrypt_busy = 0;
+    double hash_busy = 0;
+    std::size_t decrypt_workers = 0;
+    u64 bytes = 0;
+
+    // Fraction of the run time each stage was busy, in [0, 1]. The stage
+    // closest to 1 is the bottleneck.
+    double ReadUtilization() const;
+    double DecryptUtilization() const;
+    double HashUtilization() const;
+  };
+
+  // Receives the digest of each block, in order
+  using BlockCallback = std::function<void(std::size_t index,
+                                           const Crypto::Sha256Digest &digest)>;
+
+  // Called after each hashed chunk. Returning false cancels the run.
+  using ProgressCallback =
+      std::function<bool(std::size_t done, std::size_t total)>;
+
+  // decrypt_workers = 0 picks a count from the hardware concurrency
+  explicit HashPipeline(std::size_t chunk_size = 0x400000,
+                        std::size_t decrypt_workers = 0);
+  ~HashPipeline();
+
+  void SetProgressCallback(ProgressCallback callback);
+
+  // Hashes file as consecutive blocks of block_size bytes; the last block
+  // may be shorter. Returns false if the run was canceled or a read came up
+  // short, in which case the remaining blocks are not reported. If a read,
+  // a decryption or a callback throws, the run stops and the first exception
+  // is rethrown here.
+  bool Run(FilePtr file, std::size_t block_size,
+           const BlockCallback &on_block);
+
+  // Hashes the whole file as one block. Returns an empty digest on failure.
+  byte_seq Sha256(FilePtr file);
+
+  const Stats &GetStats() const;
+
+private:
+  struct Chunk;
+  using ChunkPtr = std::unique_ptr<Chunk>;
+
+  // Runs the reader stage (or a decrypt worker) of each run
+  void StageThread(bool reader);
+  void Reader(File &source, const SplitFile *split, std::size_t size);
+  void Decryptor(const SplitFile &split);
+
+  // Cancels the run for an exception thrown by a stage
+  void Fail(std::exception_ptr exception);
+
+  // Cancels the run and waits until the stage threads are done with it
+  void StopStages();
+
+  std::size_t chunk_size;
+  std::size_t decrypt_workers;
+  ProgressCallback progress;
+  Stats stats;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<ChunkPtr> free_chunks;
+  std::deque<ChunkPtr> to_decrypt;
+  std::map<std::size_t, ChunkPtr> to_hash;
+  std::size_t chunks_read = 0;
+  bool read_done = false;
+  bool cancel = false;
+  std::exception_ptr error;
+
+  // The current run, and the stage threads still working on it
+  File *run_source = nullptr;
+  const SplitFile *run_split = nullptr;
+  std::size_t run_size = 0;
+  std::size_t generation = 0;
+  std::size_t running = 0;
+
+  std::vector<std::thread> threads;
+  bool stop = false;
+};
+
+} // namespace FB
@@ -0,0 +1,150 @@
+#include "core/file_backend/ivfc_verified_file.h"
+#include "core/crypto/sha256.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace FB {
+
+static std::string ErrorMessage(std::size_t level, std::size_t pos) {
+  char message[80];
+  std::snprintf(message, sizeof(message),
+                "IVFC level %zu block at 0x%zX failed verification", level,
+                pos);
+  return message;
+}
+
+IvfcVerificationError::IvfcVerificationError(std::size_t level_,
+                                             std::size_t pos_,
+                                             std::size_t size_)
+    : std::runtime_error(ErrorMessage(level_, pos_)), level(level_),
+      pos(pos_), size(size_) {}
+
+IvfcVerifiedFile::IvfcVerifiedFile(FilePtr master_hash,
+                                   std::vector<Level> levels_,
+                                   std::size_t size)
+    : master_hash(std::move(master_hash)), size(size) {
+  for (auto &level : levels_) {
+    std::size_t level_size = level.data->GetSize();
+    std::size_t blocks = (level_size + level.block_size - 1) / level.block_size;
+    auto verified = std::make_unique<std::atomic<u64>[]>((blocks + 63) / 64);
+    levels.push_back({std::move(level.data), level.block_size, level_size,
+                      std::move(verified)});
+  }
+  if (!levels.empty())
+    this->size = std::min(size, levels.back().size);
+}
+
+std::size_t IvfcVerifiedFile::GetSize() { return size; }
+
+std::size_t IvfcVerifiedFile::ReadInto(std::size_t pos, std::size_t size,
+                                       byte *dest) {
+  if (levels.empty() || pos >= this->size)
+    return 0;
+  size = std::min(size, this->size - pos);
+  return ReadLevel(levels.size() - 1, pos, size, dest);
+}
+
+IvfcVerifiedFile::Stats IvfcVerifiedFile::GetStats() const {
+  return {hashed_blocks, failed_blocks};
+}
+
+std::size_t IvfcVerifiedFile::ReadLevel(std::size_t level, std::size_t pos,
+                                        std::size_t size, byte *dest) {
+  const LevelState &state = levels[level];
+  if (pos >= state.size)
+    return 0;
+  size = std::min(size, state.size - pos);
+
+  // whole blocks are read, so that they can be hashed
+  std::size_t first = pos / state.block_size;
+  std::size_t last = (pos + size + state.block_size - 1) / state.block_size;
+  std::size_t begin = first * state.block_size;
+  std::size_t end = std::min(last * state.block_size, state.size);
+  byte_seq buffer(end - begin);
+  std::size_t got = state.data->ReadInto(begin, buffer.size(), buffer.data());
+
+  CheckBlocks(level, first, last - first, buffer.data(), got);
+  std::size_t end_pos = std::min(begin + got, pos + size);
+  if (end_pos <= pos)
+    return 0;
+  std::memcpy(dest, buffer.data() + (pos - begin), end_pos - pos);
+  return end_pos - pos;
+}
+
+void IvfcVerifiedFile::CheckBlocks(std::size_t level, std::size_t first,
+                                   std::size_t count, const byte *data,
+                                   std::size_t got) {
+  LevelState &state = levels[level];
+  std::size_t block_size = state.block_size;
+  std::size_t i = 0;
+  while (i < count) {
+    if (IsVerified(state, first + i)) {
+      ++i;
+      continue;
+    }
+
+    // a run of blocks not checked yet, whose hashes are read in one go
+    std::size_t run_end = i + 1;
+    while (run_end < count && !IsVerified(state, first + run_end))
+      ++run_end;
+    std::size_t run = run_end - i;
+    byte_seq expected(run * Crypto::SHA256_DIGEST_SIZE);
+    std::size_t hash_pos = (first + i) * Crypto::SHA256_DIGEST_SIZE;
+    std::size_t hash_got =
+        level == 0
+            ? master_hash->ReadInto(hash_pos, expected.size(), expected.data())
+            : ReadLevel(level - 1, hash_pos, expected.size(), expected.data());
+
+    // the last block of the level is hashed as far as it exists
+    std::vector<Crypto::Sha256Digest> digests(run);
+    std::size_t offset = i * block_size;
+    std::size_t available = got > offset ? got - offset : 0;
+    std::size_t full = std::min(run, available / block_size);
+    Crypto::Sha256::DigestBlocks(data + offset, block_size, full,
+                                 digests.data());
+    for (std::size_t j = full; j < run; ++j) {
+      std::size_t block_offset = offset + j * block_size;
+      std::size_t block_end =
+          std::min(state.size - first * block_size, block_offset + block_size);
+      if (got < block_end) {
+        // the data could not be read, which counts as a failure
+        digests.resize(j);
+        break;
+      }
+      digests[j] =
+          Crypto::Sha256::Digest(data + block_offset, block_end - block_offset);
+    }
+    hashed_blocks += digests.size();
+
+    for (std::size_t j = 0; j < run; ++j) {
+      std::size_t hash_offset = j * Crypto::SHA256_DIGEST_SIZE;
+      bool match =
+          j < digests.size() &&
+          hash_got >= hash_offset + Crypto::SHA256_DIGEST_SIZE &&
+          std::memcmp(digests[j].data(), expected.data() + hash_offset,
+                      Crypto::SHA256_DIGEST_SIZE) == 0;
+      if (!match) {
+        ++failed_blocks;
+        std::size_t block_pos = (first + i + j) * block_size;
+        throw IvfcVerificationError(
+            level, block_pos, std::min(block_size, state.size - block_pos));
+      }
+      SetVerified(state, first + i + j);
+    }
+    i = run_end;
+  }
+}
+
+bool IvfcVerifiedFile::IsVerified(const LevelState &level,
+                                  std::size_t block) const {
+  return (level.verified[block / 64].load(std::memory_order_acquire) >>
+          (block % 64)) &
+         1;
+}
+
+void IvfcVerifiedFile::SetVerified(LevelState &level, std::size_t block) {
+  level.verified[block / 64].fetch_or(u64(1) << (block % 64),
+                                      std::memory_order_release);
+}
+
+} // namespace FB
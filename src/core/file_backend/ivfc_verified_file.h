@@ -0,0 +1,77 @@
+#pragma once
+
+#include "core/file_backend/file.h"
+#include <atomic>
+#include <stdexcept>
+
+namespace FB {
+
+// The bytes pos to pos + size - 1 of a level did not match their hash. level
+// is the index into the levels given to IvfcVerifiedFile.
+class IvfcVerificationError : public std::runtime_error {
+public:
+  IvfcVerificationError(std::size_t level_, std::size_t pos_,
+                        std::size_t size_);
+
+  std::size_t level;
+  std::size_t pos;
+  std::size_t size;
+};
+
+// Serves the bottom level of an IVFC hash tree, such as RomFS Level 3, and
+// checks every block against the tree as it is read. A block is checked
+// together with the blocks of the upper levels that hold its hash. Blocks
+// that passed are remembered in a bitmap and not hashed again.
+//
+// A read that reaches a block that fails, or that can't be read, throws
+// IvfcVerificationError instead of returning a short read, which would look
+// like the end of the file.
+class IvfcVerifiedFile : public File {
+public:
+  struct Level {
+    FilePtr data;
+    std::size_t block_size;
+  };
+
+  struct Stats {
+    u64 hashed_blocks;
+    u64 failed_blocks;
+  };
+
+  // The blocks of levels[0] are checked against the trusted hashes in
+  // master_hash, and those of levels[i] against the hashes stored in
+  // levels[i - 1]. The first size bytes of the last level are served.
+  IvfcVerifiedFile(FilePtr master_hash, std::vector<Level> levels,
+                   std::size_t size);
+
+  std::size_t GetSize() override;
+  std::size_t ReadInto(std::size_t pos, std::size_t size, byte *dest) override;
+
+  Stats GetStats() const;
+
+private:
+  struct LevelState {
+    FilePtr data;
+    std::size_t block_size;
+    std::size_t size;
+    std::unique_ptr<std::atomic<u64>[]> verified;
+  };
+
+  std::size_t ReadLevel(std::size_t level, std::size_t pos, std::size_t size,
+                        byte *dest);
+
+  // Checks count blocks from first, whose data (got bytes of it) is at data.
+  // Throws IvfcVerificationError for the first block that fails.
+  void CheckBlocks(std::size_t level, std::size_t first, std::size_t count,
+                   const byte *data, std::size_t got);
+
+  bool IsVerified(const LevelState &level, std::size_t block) const;
+  void SetVerified(LevelState &level, std::size_t block);
+
+  FilePtr master_hash;
+  std::vector<LevelState> levels;
+  std::size_t size;
+  std::atomic<u64> hashed_blocks{0}, failed_blocks{0};
+};
+
+} // namespace FB
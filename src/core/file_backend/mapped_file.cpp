@@ -0,0 +1,196 @@
+#include "core/file_backend/mapped_file.h"
+#include "core/file_backend/disk_file.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace FB {
+
+// (device, file index) pair that identifies a file regardless of its path
+using FileId = std::pair<u64, u64>;
+
+class MappedFile : public File {
+public:
+  MappedFile(const byte *data, std::size_t file_size, bool has_identity,
+             FileIdentity identity)
+      : data(data), file_size(file_size), has_identity(has_identity),
+        identity(std::move(identity)) {}
+
+  ~MappedFile() {
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<byte *>(data), file_size);
+#endif
+  }
+
+  std::size_t GetSize() override { return file_size; }
+
+  std::size_t ReadInto(std::size_t pos, std::size_t size,
+                       byte *dest) override {
+    if (pos >= file_size) {
+      return 0;
+    }
+
+    size = std::min(size, file_size - pos);
+    std::memcpy(dest, data + pos, size);
+    return size;
+  }
+
+  const byte *View(std::size_t pos, std::size_t size) override {
+    if (pos > file_size || size > file_size - pos) {
+      return nullptr;
+    }
+
+    return data + pos;
+  }
+
+  bool GetOrigin(FileOrigin &origin) override {
+    if (!has_identity)
+      return false;
+    origin = FileOrigin{};
+    origin.identity = identity;
+    return true;
+  }
+
+private:
+  const byte *data;
+  std::size_t file_size;
+  bool has_identity;
+  FileIdentity identity;
+};
+
+// A mapping and the state of the file it was made from. A file that was
+// resized or rewritten since gets a new mapping, as the old one would have a
+// wrong size, and reading past the new end of the file would fault.
+struct Registered {
+  std::weak_ptr<File> file;
+  u64 size;
+  u64 modified;
+};
+
+static std::mutex registry_mutex;
+static std::map<FileId, Registered> registry;
+
+// Looks up an alive mapping of the same, unchanged file, or maps it and
+// registers the new mapping. Returns nullptr if mapping is not possible.
+static FilePtr MapFile(const std::string &file_name) {
+#ifdef _WIN32
+  HANDLE handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+  if (handle == INVALID_HANDLE_VALUE)
+    return nullptr;
+
+  BY_HANDLE_FILE_INFORMATION info;
+  if (!GetFileInformationByHandle(handle, &info)) {
+    CloseHandle(handle);
+    return nullptr;
+  }
+
+  FileId id{info.dwVolumeSerialNumber,
+            ((u64)info.nFileIndexHigh << 32) | info.nFileIndexLow};
+  u64 size = ((u64)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+  u64 modified = ((u64)info.ftLastWriteTime.dwHighDateTime << 32) |
+                 info.ftLastWriteTime.dwLowDateTime;
+#else
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd == -1)
+    return nullptr;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  FileId id{(u64)info.st_dev, (u64)info.st_ino};
+  u64 size = (u64)info.st_size;
+#ifdef __APPLE__
+  const timespec &modified_time = info.st_mtimespec;
+#else
+  const timespec &modified_time = info.st_mtim;
+#endif
+  u64 modified =
+      (u64)modified_time.tv_sec * 1000000000 + modified_time.tv_nsec;
+#endif
+
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  FilePtr file;
+  auto found = registry.find(id);
+  if (found != registry.end() && found->second.size == size &&
+      found->second.modified == modified) {
+    file = found->second.file.lock();
+  }
+
+  // empty files and files exceeding the address space can't be mapped
+  if (!file && size != 0 && size <= SIZE_MAX) {
+    // the identity is looked up by name, so it only counts if it is the file
+    // that was opened
+    FileIdentity identity;
+    bool has_identity = GetFileIdentity(file_name, identity) &&
+                        identity.device == id.first &&
+                        identity.index == id.second && identity.size == size &&
+                        identity.modified == modified;
+#ifdef _WIN32
+    HANDLE mapping =
+        CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) {
+      void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      // the view keeps the mapping object alive
+      CloseHandle(mapping);
+      if (data) {
+        file = std::make_shared<MappedFile>(static_cast<const byte *>(data),
+                                            (std::size_t)size, has_identity,
+                                            std::move(identity));
+      }
+    }
+#else
+    void *data = mmap(nullptr, (std::size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data != MAP_FAILED) {
+      file = std::make_shared<MappedFile>(static_cast<const byte *>(data),
+                                          (std::size_t)size, has_identity,
+                                          std::move(identity));
+    }
+#endif
+    if (file) {
+      // replaces the mapping of the file before it changed, if any
+      registry[id] = {file, size, modified};
+    }
+  }
+
+  // the mapping stays valid after the file is closed
+#ifdef _WIN32
+  CloseHandle(handle);
+#else
+  close(fd);
+#endif
+
+  // drop registry entries of released mappings
+  for (auto iter = registry.begin(); iter != registry.end();) {
+    if (iter->second.file.expired())
+      iter = registry.erase(iter);
+    else
+      ++iter;
+  }
+
+  return file;
+}
+
+FilePtr OpenMappedFile(const std::string &file_name) {
+  if (FilePtr file = MapFile(file_name))
+    return file;
+  return OpenDiskFile(file_name);
+}
+
+} // namespace FB
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "core/file_backend/file.h"
+#include <string>
+
+namespace FB {
+
+// Opens a read-only memory mapping of the file. Opening the same file again
+// while it is still alive returns the shared mapping. Falls back to
+// OpenDiskFile if the file can't be mapped.
+FilePtr OpenMappedFile(const std::string &file_name);
+
+} // namespace FB
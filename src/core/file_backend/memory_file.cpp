@@ -1,4 +1,5 @@
 #include "core/file_backend/memory_file.h"
+#include <algorithm>
 
 namespace FB {
 
@@ -8,12 +9,22 @@ MemoryFile::MemoryFile(byte_seq &&v) : byte_seq(std::move(v)) {}
 
 std::size_t MemoryFile::GetSize() { return size(); }
 
-byte_seq MemoryFile::Read(std::size_t pos, std::size_t read_size) {
+std::size_t MemoryFile::ReadInto(std::size_t pos, std::size_t read_size,
+                                 byte *dest) {
   if (pos >= size()) {
-    return {};
+    return 0;
   }
 
   read_size = std::min(read_size, size() - pos);
-  return byte_seq(begin() + pos, begin() + pos + read_size);
+  std::memcpy(dest, data() + pos, read_size);
+  return read_size;
 }
-} // namespace FB
\ No newline at end of file
+
+const byte *MemoryFile::View(std::size_t pos, std::size_t view_size) {
+  if (pos > size() || view_size > size() - pos) {
+    return nullptr;
+  }
+
+  return data() + pos;
+}
+} // namespace FB
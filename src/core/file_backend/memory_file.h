@@ -13,7 +13,9 @@ public:
   MemoryFile(byte_seq &&);
 
   std::size_t GetSize() override;
-  byte_seq Read(std::size_t pos, std::size_t size) override;
+  std::size_t ReadInto(std::size_t pos, std::size_t read_size,
+                       byte *dest) override;
+  const byte *View(std::size_t pos, std::size_t view_size) override;
 };
 
 } // namespace FB
\ No newline at end of file
@@ -11,13 +11,21 @@ std::size_t PatchFile::GetSize() {
   return std::max(base->GetSize(), patch_offset + patch->GetSize());
 }
 
-byte_seq PatchFile::Read(std::size_t pos, std::size_t read_size) {
-  std::size_t base_size = base->GetSize();
-  byte_seq result;
+std::size_t PatchFile::ReadInto(std::size_t pos, std::size_t read_size,
+                                byte *dest) {
+  std::size_t file_size = GetSize();
+  if (pos >= file_size) {
+    return 0;
+  }
+  read_size = std::min(read_size, file_size - pos);
+
+  std::size_t done = 0;
   if (pos < patch_offset) {
-    std::size_t pre_size =
-        std::min({read_size, patch_offset - pos, base_size - pos});
-    result += base->Read(pos, pre_size);
+    std::size_t pre_size = std::min(read_size, patch_offset - pos);
+    std::size_t got = base->ReadInto(pos, pre_size, dest);
+    done += got;
+    if (got != pre_size)
+      return done;
     read_size -= pre_size;
     pos += pre_size;
   }
@@ -27,15 +35,18 @@ byte_seq PatchFile::Read(std::size_t pos, std::size_t read_size) {
 
   if (read_size != 0 && pos < patch_end) {
     std::size_t in_size = std::min(patch_end - pos, read_size);
-    result += patch->Read(pos - patch_offset, in_size);
+    std::size_t got = patch->ReadInto(pos - patch_offset, in_size, dest + done);
+    done += got;
+    if (got != in_size)
+      return done;
     read_size -= in_size;
     pos += in_size;
   }
 
   if (read_size != 0) {
-    result += base->Read(pos, read_size);
+    done += base->ReadInto(pos, read_size, dest + done);
   }
 
-  return result;
+  return done;
 }
-} // namespace FB
\ No newline at end of file
+} // namespace FB
@@ -9,7 +9,7 @@ public:
   PatchFile(FilePtr base_, FilePtr patch_, std::size_t patch_offset_);
 
   std::size_t GetSize() override;
-  byte_seq Read(std::size_t pos, std::size_t size) override;
+  std::size_t ReadInto(std::size_t pos, std::size_t size, byte *dest) override;
 
 private:
   FilePtr base;
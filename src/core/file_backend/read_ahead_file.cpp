@@ -0,0 +1,146 @@
+#include "core/file_backend/read_ahead_file.h"
+#include <algorithm>
+
+namespace FB {
+
+ReadAheadFile::ReadAheadFile(FilePtr parent, std::size_t window_size,
+                             std::size_t depth)
+    : parent(std::move(parent)), window_size(window_size), depth(depth) {}
+
+ReadAheadFile::~ReadAheadFile() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cv_request.notify_all();
+  if (worker.joinable())
+    worker.join();
+}
+
+std::size_t ReadAheadFile::GetSize() { return parent->GetSize(); }
+
+bool ReadAheadFile::GetSplit(SplitFile &split) {
+  return parent->GetSplit(split);
+}
+
+bool ReadAheadFile::GetOrigin(FileOrigin &origin) {
+  return parent->GetOrigin(origin);
+}
+
+std::size_t ReadAheadFile::ReadInto(std::size_t pos, std::size_t size,
+                                    byte *dest) {
+  std::size_t file_size = GetSize();
+  if (pos >= file_size) {
+    return 0;
+  }
+  size = std::min(size, file_size - pos);
+  std::size_t end = pos + size;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  bool sequential = pos == next_pos;
+  next_pos = end;
+  if (!sequential) {
+    Reset();
+    lock.unlock();
+    return parent->ReadInto(pos, size, dest);
+  }
+
+  // windows behind the current position will not be read again
+  windows.erase(windows.begin(), windows.lower_bound(pos / window_size));
+  Schedule(end / window_size);
+
+  std::size_t done = 0;
+  while (done != size) {
+    u64 index = (pos + done) / window_size;
+    std::size_t window_pos = (std::size_t)(index * window_size);
+    std::size_t offset = pos + done - window_pos;
+    std::size_t part = std::min(size - done, window_size - offset);
+
+    auto found = windows.find(index);
+    if (found == windows.end()) {
+      // not prefetched (yet), e.g. the first read of a stream
+      lock.unlock();
+      std::size_t got = parent->ReadInto(pos + done, part, dest + done);
+      lock.lock();
+      done += got;
+      if (got != part)
+        break;
+      continue;
+    }
+
+    auto window = found->second;
+    cv_ready.wait(lock, [&] {
+      auto current = windows.find(index);
+      return window->ready || current == windows.end() ||
+             current->second != window;
+    });
+    if (!window->ready)
+      continue; // dropped by a concurrent random read
+    if (window->error)
+      std::rethrow_exception(window->error);
+    if (offset >= window->data.size())
+      break;
+    part = std::min(part, window->data.size() - offset);
+    std::memcpy(dest + done, window->data.data() + offset, part);
+    done += part;
+  }
+  return done;
+}
+
+void ReadAheadFile::Schedule(u64 first_index) {
+  u64 window_count = (GetSize() + window_size - 1) / window_size;
+  u64 last_index = std::min<u64>(first_index + depth, window_count);
+  bool added = false;
+  for (u64 index = first_index; index < last_index; ++index) {
+    if (windows.count(index))
+      continue;
+    windows.emplace(index, std::make_shared<Window>());
+    queue.push_back(index);
+    added = true;
+  }
+
+  if (added) {
+    if (!worker.joinable())
+      worker = std::thread(&ReadAheadFile::Worker, this);
+    cv_request.notify_one();
+  }
+}
+
+void ReadAheadFile::Reset() {
+  // a window being fetched keeps its own reference, so it is safe to drop
+  queue.clear();
+  windows.clear();
+  cv_ready.notify_all();
+}
+
+void ReadAheadFile::Worker() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cv_request.wait(lock, [this] { return stop || !queue.empty(); });
+    if (stop)
+      return;
+
+    u64 index = queue.front();
+    queue.pop_front();
+    auto found = windows.find(index);
+    if (found == windows.end())
+      continue;
+    auto window = found->second;
+
+    lock.unlock();
+    std::size_t window_pos = (std::size_t)(index * window_size);
+    try {
+      window->data.resize(window_size);
+      window->data.resize(
+          parent->ReadInto(window_pos, window_size, window->data.data()));
+    } catch (...) {
+      window->error = std::current_exception();
+    }
+    lock.lock();
+
+    window->ready = true;
+    cv_ready.notify_all();
+  }
+}
+
+} // namespace FB
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "core/file_backend/file.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace FB {
+
+// Detects sequential reads and prefetches the following windows of the parent
+// file on a background thread. Reading and decrypting the next windows then
+// overlaps with the consumer processing the current one. Random access is
+// forwarded to the parent as is.
+class ReadAheadFile : public File {
+public:
+  ReadAheadFile(FilePtr parent, std::size_t window_size = 0x400000,
+                std::size_t depth = 4);
+  ~ReadAheadFile();
+
+  std::size_t GetSize() override;
+  std::size_t ReadInto(std::size_t pos, std::size_t size, byte *dest) override;
+  bool GetSplit(SplitFile &split) override;
+  bool GetOrigin(FileOrigin &origin) override;
+
+private:
+  struct Window {
+    byte_seq data;
+    // what the parent read threw, rethrown to the reader of the window
+    std::exception_ptr error;
+    bool ready = false;
+  };
+
+  void Schedule(u64 first_index);
+  void Reset();
+  void Worker();
+
+  FilePtr parent;
+  std::size_t window_size;
+  std::size_t depth;
+
+  std::mutex mutex;
+  std::condition_variable cv_request, cv_ready;
+  std::size_t next_pos = 0;
+  std::map<u64, std::shared_ptr<Window>> windows;
+  std::deque<u64> queue;
+  bool stop = false;
+  std::thread worker;
+};
+
+} // namespace FB
@@ -1,4 +1,5 @@
 #include "core/file_backend/sub_file.h"
+#include <algorithm>
 
 namespace FB {
 
@@ -7,12 +8,34 @@ SubFile::SubFile(FilePtr parent, std::size_t offset, std::size_t file_size)
 
 std::size_t SubFile::GetSize() { return file_size; }
 
-byte_seq SubFile::Read(std::size_t pos, std::size_t size) {
+std::size_t SubFile::ReadInto(std::size_t pos, std::size_t size, byte *dest) {
   if (pos >= file_size) {
-    return {};
+    return 0;
   }
 
   size = std::min(size, file_size - pos);
-  return parent->Read(offset + pos, size);
+  return parent->ReadInto(offset + pos, size, dest);
 }
-} // namespace FB
\ No newline at end of file
+
+const byte *SubFile::View(std::size_t pos, std::size_t size) {
+  if (pos > file_size || size > file_size - pos) {
+    return nullptr;
+  }
+
+  return parent->View(offset + pos, size);
+}
+
+bool SubFile::GetSplit(SplitFile &split) {
+  if (!parent->GetSplit(split))
+    return false;
+  split.offset += offset;
+  return true;
+}
+
+bool SubFile::GetOrigin(FileOrigin &origin) {
+  if (!parent->GetOrigin(origin))
+    return false;
+  origin.offset += offset;
+  return true;
+}
+} // namespace FB
@@ -9,7 +9,10 @@ public:
   SubFile(FilePtr parent, std::size_t offset, std::size_t file_size);
 
   std::size_t GetSize() override;
-  byte_seq Read(std::size_t pos, std::size_t size) override;
+  std::size_t ReadInto(std::size_t pos, std::size_t size, byte *dest) override;
+  const byte *View(std::size_t pos, std::size_t size) override;
+  bool GetSplit(SplitFile &split) override;
+  bool GetOrigin(FileOrigin &origin) override;
 
 private:
   FilePtr parent;
@@ -1,3 +1,5 @@
+#pragma once
+
 #include "core/common_types.h"
 #include <string>
 
@@ -18,4 +20,88 @@ template <bool upper_case, typename T> std::string IntToHex(T value) {
     result = DigitToHex<upper_case>(digit) + result;
   }
   return result;
-}
\ No newline at end of file
+}
+// Invalid sequences are replaced with U+FFFD
+inline std::u16string Utf8ToUtf16(const std::string &str) {
+  static const u32 min_code[] = {0, 0, 0x80, 0x800, 0x10000};
+  std::u16string result;
+  std::size_t i = 0;
+  while (i < str.size()) {
+    u8 lead = (u8)str[i];
+    std::size_t length;
+    u32 code;
+    if (lead < 0x80) {
+      length = 1;
+      code = lead;
+    } else if (lead >= 0xC2 && lead < 0xE0) {
+      length = 2;
+      code = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead < 0xF0) {
+      length = 3;
+      code = lead & 0x0F;
+    } else if (lead >= 0xF0 && lead < 0xF5) {
+      length = 4;
+      code = lead & 0x07;
+    } else {
+      result += u'\uFFFD';
+      ++i;
+      continue;
+    }
+
+    std::size_t got = 1;
+    for (; got < length && i + got < str.size(); ++got) {
+      u8 next = (u8)str[i + got];
+      if ((next & 0xC0) != 0x80)
+        break;
+      code = code << 6 | (next & 0x3F);
+    }
+    i += got;
+    // truncated, overlong, surrogate or out of range
+    if (got != length || code < min_code[length] || code > 0x10FFFF ||
+        (code >= 0xD800 && code < 0xE000)) {
+      result += u'\uFFFD';
+      continue;
+    }
+
+    if (code < 0x10000) {
+      result += (char16_t)code;
+    } else {
+      code -= 0x10000;
+      result += (char16_t)(0xD800 + (code >> 10));
+      result += (char16_t)(0xDC00 + (code & 0x3FF));
+    }
+  }
+  return result;
+}
+
+// Unpaired surrogates are replaced with U+FFFD
+inline std::string Utf16ToUtf8(const std::u16string &str) {
+  std::string result;
+  for (std::size_t i = 0; i < str.size(); ++i) {
+    u32 code = str[i];
+    if (code >= 0xD800 && code < 0xDC00 && i + 1 < str.size() &&
+        str[i + 1] >= 0xDC00 && str[i + 1] < 0xE000) {
+      code = 0x10000 + ((code - 0xD800) << 10) + (str[i + 1] - 0xDC00);
+      ++i;
+    } else if (code >= 0xD800 && code < 0xE000) {
+      code = 0xFFFD;
+    }
+
+    if (code < 0x80) {
+      result += (char)code;
+    } else if (code < 0x800) {
+      result += (char)(0xC0 | code >> 6);
+      result += (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+      result += (char)(0xE0 | code >> 12);
+      result += (char)(0x80 | (code >> 6 & 0x3F));
+      result += (char)(0x80 | (code & 0x3F));
+    } else {
+      result += (char)(0xF0 | code >> 18);
+      result += (char)(0x80 | (code >> 12 & 0x3F));
+      result += (char)(0x80 | (code >> 6 & 0x3F));
+      result += (char)(0x80 | (code & 0x3F));
+    }
+  }
+  return result;
+}
@@ -0,0 +1,121 @@
+#include "core/thread_pool.h"
+#include <atomic>
+#include <exception>
+
+struct ThreadPool::Job {
+  const std::function<void(std::size_t)> *task;
+  std::size_t count;
+  std::atomic<std::size_t> next{0};
+
+  // guarded by the pool mutex
+  std::size_t finished = 0;
+  std::exception_ptr error;
+  std::condition_variable cv_finished;
+};
+
+ThreadPool::ThreadPool(std::size_t worker_count) {
+  workers.reserve(worker_count);
+  for (std::size_t i = 0; i < worker_count; ++i)
+    workers.emplace_back([this] { Worker(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cv_job.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+std::size_t ThreadPool::GetConcurrency() const { return workers.size() + 1; }
+
+void ThreadPool::Run(Job &job) {
+  std::size_t finished = 0;
+  std::exception_ptr error;
+  for (;;) {
+    std::size_t i = job.next++;
+    if (i >= job.count)
+      break;
+    try {
+      (*job.task)(i);
+    } catch (...) {
+      if (!error)
+        error = std::current_exception();
+    }
+    ++finished;
+  }
+  if (finished == 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (error && !job.error)
+    job.error = error;
+  job.finished += finished;
+  if (job.finished == job.count)
+    job.cv_finished.notify_all();
+}
+
+void ThreadPool::ParallelFor(std::size_t count,
+                             const std::function<void(std::size_t)> &task) {
+  if (count == 0)
+    return;
+  if (count == 1 || workers.empty()) {
+    for (std::size_t i = 0; i < count; ++i)
+      task(i);
+    return;
+  }
+
+  auto job = std::make_shared<Job>();
+  job->task = &task;
+  job->count = count;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(job);
+  }
+  if (count - 1 >= workers.size())
+    cv_job.notify_all();
+  else
+    for (std::size_t i = 0; i < count - 1; ++i)
+      cv_job.notify_one();
+
+  Run(*job);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  job->cv_finished.wait(lock, [&] { return job->finished == job->count; });
+  for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+    if (*it == job) {
+      jobs.erase(it);
+      break;
+    }
+  }
+  if (job->error)
+    std::rethrow_exception(job->error);
+}
+
+void ThreadPool::Worker() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    cv_job.wait(lock, [this] { return stop || !jobs.empty(); });
+    if (stop)
+      return;
+    std::shared_ptr<Job> job = jobs.front();
+    if (job->next >= job->count) {
+      // all tasks are taken. The owner removes it once they have finished
+      jobs.pop_front();
+      continue;
+    }
+    lock.unlock();
+    Run(*job);
+    lock.lock();
+  }
+}
+
+ThreadPool &ThreadPool::Global() {
+  static ThreadPool pool([] {
+    std::size_t threads = std::thread::hardware_concurrency();
+    return threads > 1 ? threads - 1 : 0;
+  }());
+  return pool;
+}
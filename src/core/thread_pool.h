@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for splitting CPU bound work such as
+// decryption and hashing. The thread calling ParallelFor works on the tasks
+// too, so nested or concurrent calls always make progress.
+class ThreadPool {
+public:
+  explicit ThreadPool(std::size_t worker_count);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Number of threads working on a ParallelFor, including the caller
+  std::size_t GetConcurrency() const;
+
+  // Calls task(i) for every i in [0, count) and returns once all calls have
+  // finished. If any call throws, the first exception is rethrown here.
+  void ParallelFor(std::size_t count,
+                   const std::function<void(std::size_t)> &task);
+
+  // Shared pool sized to the hardware concurrency
+  static ThreadPool &Global();
+
+private:
+  struct Job;
+
+  void Run(Job &job);
+  void Worker();
+
+  std::mutex mutex;
+  std::condition_variable cv_job;
+  std::deque<std::shared_ptr<Job>> jobs;
+  bool stop = false;
+  std::vector<std::thread> workers;
+};
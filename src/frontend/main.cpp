@@ -1,7 +1,8 @@
 #include "frontend/main.h"
 #include "core/container_backend/disk_directory.h"
 #include "core/container_backend/sd_protected.h"
-#include "core/file_backend/disk_file.h"
+#include "core/container_backend/verification_cache.h"
+#include "core/file_backend/mapped_file.h"
 #include "core/secret_backend/secret_database.h"
 #include "core/secret_backend/seeddb.h"
 #include "frontend/format_detect.h"
@@ -52,7 +53,7 @@ void MainWindow::onOpen() {
     return;
   }
   QFileInfo file_info(filename);
-  auto file = FB::OpenDiskFile(filename.toStdString());
+  auto file = FB::OpenMappedFile(filename.toStdString());
 
   if (!file) {
     QMessageBox::critical(this, tr("Error"), tr("Failed to open the file!"));
@@ -108,9 +109,13 @@ int main(int argc, char *argv[]) {
   SB::Init(QFileInfo(appdata, "secret").absoluteFilePath().toStdString());
   SB::g_seeddb.Load(
       QFileInfo(appdata, "seeddb.bin").absoluteFilePath().toStdString());
+  CB::VerificationCache::Global().Open(
+      QFileInfo(appdata, "verification").absoluteFilePath().toStdString());
 
   MainWindow main_window;
 
   main_window.show();
-  return app.exec();
+  int result = app.exec();
+  CB::VerificationCache::Global().Flush();
+  return result;
 }
\ No newline at end of file
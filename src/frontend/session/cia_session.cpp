@@ -18,8 +18,8 @@ CiaSession::CiaSession(std::shared_ptr<Session> parent_session,
   auto tmd = container->Open("Tmd");
   u16 content_count = tmd->Open("ContentCount")->ValueT<u16>();
   for (u16 i = 0; i < content_count; ++i) {
-    std::string error = container->Open(CB::WithIndex("ContentError", i))
-                            ->ValueT<std::string>();
+    std::string error =
+        container->OpenAt("ContentError", i)->ValueT<std::string>();
     if (error.empty()) {
       QPushButton *button_content = new QPushButton(tr("Content %1").arg(i));
       connect(button_content, &QPushButton::clicked,
@@ -27,7 +27,7 @@ CiaSession::CiaSession(std::shared_ptr<Session> parent_session,
       layout_partitions->addWidget(button_content, i, 0);
 
       QPushButton *button_hash = ShaSession::CreateButton(
-          this, container->Open(CB::WithIndex("ContentHash", i)),
+          this, container->OpenAt("ContentHash", i),
           "hash" + std::to_string(i), tr("Content %1 Hash").arg(i));
       layout_partitions->addWidget(button_hash, i, 1);
     } else {
@@ -36,16 +36,13 @@ CiaSession::CiaSession(std::shared_ptr<Session> parent_session,
                                    0);
     }
 
-    u32 id = tmd->Open(CB::WithIndex("ContentId", i))->ValueT<u32>();
-    u16 index = tmd->Open(CB::WithIndex("ContentIndex", i))->ValueT<u16>();
-    bool is_encrypted =
-        tmd->Open(CB::WithIndex("ContentIsEncrypted", i))->ValueT<bool>();
-    bool is_disc = tmd->Open(CB::WithIndex("ContentIsDisc", i))->ValueT<bool>();
-    bool is_cfm = tmd->Open(CB::WithIndex("ContentIsCfm", i))->ValueT<bool>();
-    bool is_optional =
-        tmd->Open(CB::WithIndex("ContentIsOptional", i))->ValueT<bool>();
-    bool is_shared =
-        tmd->Open(CB::WithIndex("ContentIsShared", i))->ValueT<bool>();
+    u32 id = tmd->OpenAt("ContentId", i)->ValueT<u32>();
+    u16 index = tmd->OpenAt("ContentIndex", i)->ValueT<u16>();
+    bool is_encrypted = tmd->OpenAt("ContentIsEncrypted", i)->ValueT<bool>();
+    bool is_disc = tmd->OpenAt("ContentIsDisc", i)->ValueT<bool>();
+    bool is_cfm = tmd->OpenAt("ContentIsCfm", i)->ValueT<bool>();
+    bool is_optional = tmd->OpenAt("ContentIsOptional", i)->ValueT<bool>();
+    bool is_shared = tmd->OpenAt("ContentIsShared", i)->ValueT<bool>();
     QString info = tr("id = 0x%1, index = %2").arg(ToHex(id)).arg(index);
     if (is_encrypted)
       info += tr(", encrypted");
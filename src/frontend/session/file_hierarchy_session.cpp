@@ -1,4 +1,5 @@
 #include "frontend/session/file_hierarchy_session.h"
+#include "core/file_backend/read_ahead_file.h"
 #include "frontend/format_detect.h"
 #include "frontend/util.h"
 #include <QFileDialog>
@@ -30,13 +31,20 @@ void FileHierarchyItem::expand() {
   if (expanded)
     return;
 
-  auto list = container->List();
-
   std::size_t row = 0;
-  for (auto &name : list) {
+  try {
+    auto list = container->List();
+    for (auto &name : list) {
+      children.push_back(std::make_unique<FileHierarchyItem>(
+          container->Open(name), row, QString::fromStdString(name), this));
+      row++;
+    }
+  } catch (const std::exception &e) {
+    // for example data that failed verification; show it in place of the
+    // children that could not be listed
     children.push_back(std::make_unique<FileHierarchyItem>(
-        container->Open(name), row, QString::fromStdString(name), this));
-    row++;
+        std::make_shared<CB::ConstContainer>(std::string(e.what())), row,
+        QObject::tr("Error: %1").arg(e.what()), this));
   }
 
   expanded = true;
@@ -164,9 +172,42 @@ void FileHierarchySession::onTreeContextMenu(const QPoint &point) {
                 }
                 auto src = item->getContainer()->ValueT<FB::FilePtr>();
 
-                auto buf = src->Read(0, src->GetSize());
-                file.write((char *)buf.data(), buf.size());
+                std::size_t size = src->GetSize();
+                std::size_t pos = 0;
+                QString error;
+                if (const byte *view = src->View(0, size)) {
+                  file.write((const char *)view, size);
+                  pos = size;
+                } else {
+                  // stream in chunks while the next ones are decrypted ahead
+                  FB::ReadAheadFile stream(src);
+                  byte_seq buf(0x100000);
+                  try {
+                    while (pos < size) {
+                      std::size_t got =
+                          stream.ReadInto(pos, buf.size(), buf.data());
+                      if (got == 0)
+                        break;
+                      file.write((char *)buf.data(), got);
+                      pos += got;
+                    }
+                  } catch (const std::exception &e) {
+                    error = QString::fromStdString(e.what());
+                  }
+                }
                 file.close();
+
+                if (pos != size) {
+                  // don't leave a truncated copy that looks complete
+                  file.remove();
+                  if (error.isEmpty())
+                    error = tr("Only %1 of %2 bytes could be read.")
+                                .arg(pos)
+                                .arg(size);
+                  QMessageBox::critical(this, tr("Error"),
+                                        tr("Failed to export the file: %1")
+                                            .arg(error));
+                }
               });
 
       connect(menu.addAction(tr("Open")), &QAction::triggered, [this, item]() {
@@ -1,4 +1,5 @@
 #include "frontend/session/romfs_hash_session.h"
+#include "core/container_backend/ivfc_verifier.h"
 #include "frontend/util.h"
 #include <QHBoxLayout>
 #include <QVBoxLayout>
@@ -7,46 +8,41 @@ RomfsHashVerifier::RomfsHashVerifier(CB::ContainerPtr container_)
     : container(std::move(container_)) {}
 
 void RomfsHashVerifier::run() {
-  CB::ContainerPtr levels[3] = {
-      container->Open("Level0"),
-      container->Open("Level1"),
-      container->Open("Level2"),
-  };
-
-  u64 sizes[3] = {
-      levels[0]->Open("Size")->ValueT<u64>(),
-      levels[1]->Open("Size")->ValueT<u64>(),
-      levels[2]->Open("Size")->ValueT<u64>(),
-  };
-
-  emit initProgress((int)(sizes[0] + sizes[1] + sizes[2]));
-
-  int total = 0;
-  int verified = 0;
-  for (unsigned li = 0; li < 3; ++li) {
-    emit appendLog(tr("Verifying level %1 over level %2").arg(li).arg(li + 1));
-    for (u64 i = 0; i < sizes[li]; ++i) {
-      if (isInterruptionRequested()) {
-        emit appendLog(tr("Canceled"));
-        return;
-      }
-
-      if (levels[li]
-              ->Open(CB::WithIndex("Hash", i))
-              ->Open("Match")
-              ->ValueT<bool>()) {
-        ++verified;
-      } else {
-        emit appendLog(tr("Hash %1 mismatch").arg(i));
-      }
-
-      ++total;
-      emit updateProgress(total);
+  CB::IvfcVerifier verifier(container);
+  emit initProgress((int)verifier.GetTotalBlocks());
+  emit appendLog(tr("Verifying levels 0 to 2"));
+
+  // progress is throttled by the verifier, so this doesn't flood the UI
+  verifier.SetProgressCallback([this](u64 done, u64) {
+    emit updateProgress((int)done);
+    return !isInterruptionRequested();
+  });
+  if (!verifier.Run()) {
+    emit appendLog(tr("Canceled, the next run resumes from here"));
+    return;
+  }
+
+  for (const auto &range : verifier.GetMismatches()) {
+    if (range.count == 1) {
+      emit appendLog(tr("Level %1 hash %2 mismatch")
+                         .arg(range.level)
+                         .arg(range.first));
+    } else {
+      emit appendLog(tr("Level %1 hash %2 to %3 mismatch")
+                         .arg(range.level)
+                         .arg(range.first)
+                         .arg(range.first + range.count - 1));
     }
   }
 
-  emit appendLog(
-      tr("Finished with %1 passed / %2 total").arg(verified).arg(total));
+  if (verifier.GetSkippedBlocks() != 0) {
+    emit appendLog(tr("%1 blocks passed in an earlier run and were skipped")
+                       .arg(verifier.GetSkippedBlocks()));
+  }
+
+  emit appendLog(tr("Finished with %1 passed / %2 total")
+                     .arg(verifier.GetPassedBlocks())
+                     .arg(verifier.GetTotalBlocks()));
 }
 
 RomfsHashSession::RomfsHashSession(std::shared_ptr<Session> parent_session,